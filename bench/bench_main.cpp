@@ -0,0 +1,302 @@
+#include <benchmark/benchmark.h>
+#include <opencv2/opencv.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <methods.h>
+#include <generator.h>
+#include <evaluator.h>
+#include <bootstrap.h>
+#include <storage.h>
+#include <results.h>
+
+namespace fs = std::filesystem;
+
+// Тестовое изображение заданной глубины, заполненное шумом вокруг уровня 128
+static cv::Mat makeImage(int size, int depth)
+{
+    cv::Mat image(size, size, CV_32FC1);
+    cv::randn(image, 128.0, 16.0);
+    if (depth == CV_32F)
+        return image;
+
+    cv::Mat converted;
+    image.convertTo(converted, depth);
+    return converted;
+}
+
+// Маска с заданной долей (в процентах) ненулевых пикселей
+static cv::Mat makeMask(int size, int density)
+{
+    if (density >= 100)
+        return cv::Mat(size, size, CV_8UC1, cv::Scalar(255));
+
+    cv::Mat noise(size, size, CV_32FC1);
+    cv::randu(noise, 0.0, 100.0);
+    cv::Mat mask;
+    cv::threshold(noise, mask, 100.0 - density, 255.0, cv::THRESH_BINARY);
+    mask.convertTo(mask, CV_8U);
+    return mask;
+}
+
+// Коллаж 1280x1280, устроенный так же, как в generateAll
+static cv::Mat makeCollage()
+{
+    ImageGenerator generator(0, 30.0, 42);
+    cv::Mat collage(1280, 1280, CV_32FC1);
+    for (int row = 0; row < 5; row++)
+    {
+        for (int col = 0; col < 5; col++)
+        {
+            cv::Mat cell = generator.generate_cell(44.0 * (row + 1), 0.5 * (col + 1));
+            cell.copyTo(collage(cv::Rect(col * 256, row * 256, 256, 256)));
+        }
+    }
+    return collage;
+}
+
+// Аргументы: размер изображения, глубина исходных данных, плотность маски (%).
+// Как и в evaluateCollage, в замер входит приведение к CV_32F.
+static void momentArgs(benchmark::internal::Benchmark *b)
+{
+    for (int size : {256, 1024, 2048})
+        for (int depth : {CV_8U, CV_16U, CV_32F})
+            for (int density : {10, 50, 100})
+                b->Args({size, depth, density});
+}
+
+static void BM_Skewness(benchmark::State &state)
+{
+    const int size = static_cast<int>(state.range(0));
+    cv::Mat image = makeImage(size, static_cast<int>(state.range(1)));
+    cv::Mat mask = makeMask(size, static_cast<int>(state.range(2)));
+
+    for (auto _ : state)
+    {
+        cv::Mat image_float;
+        image.convertTo(image_float, CV_32F);
+        benchmark::DoNotOptimize(getSkewnessValue(image_float, mask));
+    }
+    state.SetItemsProcessed(state.iterations() * image.total());
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_Skewness)->Apply(momentArgs)->ArgNames({"size", "depth", "density"});
+
+static void BM_Kurtosis(benchmark::State &state)
+{
+    const int size = static_cast<int>(state.range(0));
+    cv::Mat image = makeImage(size, static_cast<int>(state.range(1)));
+    cv::Mat mask = makeMask(size, static_cast<int>(state.range(2)));
+
+    for (auto _ : state)
+    {
+        cv::Mat image_float;
+        image.convertTo(image_float, CV_32F);
+        benchmark::DoNotOptimize(getKurtosisValue(image_float, mask));
+    }
+    state.SetItemsProcessed(state.iterations() * image.total());
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_Kurtosis)->Apply(momentArgs)->ArgNames({"size", "depth", "density"});
+
+// Аргументы: число каналов; все каналы за один проход по маске 1024x1024
+static void BM_ChannelMoments(benchmark::State &state)
+{
+    const int channels = static_cast<int>(state.range(0));
+    cv::Mat image(1024, 1024, CV_MAKETYPE(CV_32F, channels));
+    cv::randn(image, cv::Scalar::all(128.0), cv::Scalar::all(16.0));
+    std::vector<Span> spans = maskToSpans(makeMask(1024, 100));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(getChannelMoments(image, spans));
+    }
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_ChannelMoments)->Arg(1)->Arg(3)->Arg(4)->ArgName("channels");
+
+// Аргументы: глубина хранения; ядро работает прямо по компактным данным коллажа
+static void BM_StoredMoments(benchmark::State &state)
+{
+    cv::Mat collage = makeCollage();
+    cv::Mat image;
+    collage.convertTo(image, static_cast<int>(state.range(0)));
+    std::vector<Span> spans = maskToSpans(createCollageMask());
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(getChannelMoments(image, spans));
+    }
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_StoredMoments)->Arg(CV_16U)->Arg(CV_16F)->Arg(CV_32F)->ArgName("depth");
+
+// Аргумент: маска STAT_*; только моменты против моментов с гистограммой
+static void BM_ChannelStatistics(benchmark::State &state)
+{
+    cv::Mat image = makeImage(2048, CV_32F);
+    std::vector<Span> spans = maskToSpans(makeMask(2048, 100));
+    const unsigned statistics = static_cast<unsigned>(state.range(0));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(getChannelStatistics(image, spans, statistics));
+    }
+    state.SetBytesProcessed(state.iterations() * image.total() * image.elemSize());
+}
+BENCHMARK(BM_ChannelStatistics)->Arg(STAT_MOMENTS)->Arg(STAT_ALL)->ArgName("stats");
+
+// Аргументы: допуск стандартной ошибки в тысячных; кадр 2048x2048
+static void BM_ApproxMoments(benchmark::State &state)
+{
+    cv::Mat image = makeImage(2048, CV_32F);
+    std::vector<Span> spans = maskToSpans(makeMask(2048, 100));
+    ApproxOptions options;
+    options.tolerance = state.range(0) / 1000.0;
+
+    long long samples = 0;
+    for (auto _ : state)
+    {
+        ApproxMoments m = getApproxMoments(image, spans, options);
+        samples = m.samples;
+        benchmark::DoNotOptimize(m);
+    }
+    state.counters["samples"] = static_cast<double>(samples);
+}
+BENCHMARK(BM_ApproxMoments)->Arg(20)->Arg(50)->ArgName("tol_x1000");
+
+static void BM_GenerateCell(benchmark::State &state)
+{
+    ImageGenerator generator(static_cast<int>(state.range(0)), 30.0, 42);
+
+    for (auto _ : state)
+    {
+        cv::Mat cell = generator.generate_cell(132.0, 1.5);
+        benchmark::DoNotOptimize(cell.data);
+    }
+    state.SetItemsProcessed(state.iterations() * 256 * 256);
+}
+BENCHMARK(BM_GenerateCell)->DenseRange(0, 2)->ArgName("dist");
+
+static void BM_ApplyGaussianNoise(benchmark::State &state)
+{
+    ImageGenerator generator(0, 30.0, 42);
+    cv::Mat collage = makeCollage();
+
+    for (auto _ : state)
+    {
+        cv::Mat noisy = generator.applyGaussianNoise(collage, 30.0);
+        benchmark::DoNotOptimize(noisy.data);
+    }
+    state.SetBytesProcessed(state.iterations() * collage.total() * collage.elemSize());
+}
+BENCHMARK(BM_ApplyGaussianNoise);
+
+static void BM_EvaluateCollage(benchmark::State &state)
+{
+    cv::Mat collage = makeCollage();
+
+    for (auto _ : state)
+    {
+        // Маска строится на каждый вызов, как в текущем eval
+        json result = evaluateCollage(collage, createCollageMask());
+        benchmark::DoNotOptimize(result);
+    }
+    state.SetBytesProcessed(state.iterations() * collage.total() * collage.elemSize());
+}
+BENCHMARK(BM_EvaluateCollage)->Unit(benchmark::kMillisecond);
+
+// Аргументы: число перевыборок для одной ячейки 228x228 (блоки 16x16)
+static void BM_BootstrapCell(benchmark::State &state)
+{
+    cv::Mat cell = makeImage(228, CV_32F);
+    std::vector<Span> spans = maskToSpans(makeMask(228, 100));
+    std::vector<MomentSummary> blocks = blockSummaries(cell, spans, 16);
+    BootstrapOptions options;
+    options.resamples = static_cast<int>(state.range(0));
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(resampleCell(blocks, options, 0));
+    }
+    state.SetItemsProcessed(state.iterations() * options.resamples);
+}
+BENCHMARK(BM_BootstrapCell)->Arg(1000)->Arg(5000)->ArgName("resamples")->Unit(benchmark::kMillisecond);
+
+// Аргументы: формат хранения (0 — float32, 1 — float16, 2 — scaled16)
+static void BM_TiffWrite(benchmark::State &state)
+{
+    cv::Mat collage = makeCollage();
+    const auto format = static_cast<StorageFormat>(state.range(0));
+    const std::string path = (fs::temp_directory_path() / "bench_collage_write.tiff").string();
+
+    for (auto _ : state)
+    {
+        writeCollage(path, collage, format);
+    }
+    state.SetBytesProcessed(state.iterations() * fs::file_size(path));
+    fs::remove(path);
+    fs::remove(storageSidecarPath(path));
+}
+BENCHMARK(BM_TiffWrite)->DenseRange(0, 2)->ArgName("storage")->Unit(benchmark::kMillisecond);
+
+static void BM_TiffRead(benchmark::State &state)
+{
+    cv::Mat collage = makeCollage();
+    const auto format = static_cast<StorageFormat>(state.range(0));
+    const std::string path = (fs::temp_directory_path() / "bench_collage_read.tiff").string();
+    writeCollage(path, collage, format);
+
+    for (auto _ : state)
+    {
+        StorageInfo info;
+        cv::Mat image = readStoredCollage(path, info);
+        if (image.empty())
+        {
+            state.SkipWithError("Failed to read TIFF");
+            break;
+        }
+        benchmark::DoNotOptimize(image.data);
+    }
+    state.SetBytesProcessed(state.iterations() * fs::file_size(path));
+    fs::remove(path);
+    fs::remove(storageSidecarPath(path));
+}
+BENCHMARK(BM_TiffRead)->DenseRange(0, 2)->ArgName("storage")->Unit(benchmark::kMillisecond);
+
+// Чтение результатов на 10^5 ячеек: 0 — DOM (json::parse), 1 — SAX (readCellRecords)
+static void BM_ReadResults(benchmark::State &state)
+{
+    const std::string path = (fs::temp_directory_path() / "bench_results.json").string();
+    {
+        json evaluation;
+        for (int i = 0; i < 100000; i++)
+            evaluation["cells"].push_back({{"row", i / 316}, {"column", i % 316},
+                                           {"evaluated_skewness", 0.01 * i}, {"evaluated_kurtosis", -0.01 * i}});
+        std::ofstream(path) << evaluation.dump(4);
+    }
+    const bool sax = state.range(0) == 1;
+
+    for (auto _ : state)
+    {
+        double sum = 0.0;
+        if (sax)
+        {
+            readCellRecords(path, [&](const CellRecord &cell)
+                            { sum += cell.evaluated_skewness; });
+        }
+        else
+        {
+            std::ifstream in(path);
+            const json evaluation = json::parse(in);
+            for (const json &cell : evaluation["cells"])
+                sum += cell["evaluated_skewness"].get<double>();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * fs::file_size(path));
+    fs::remove(path);
+}
+BENCHMARK(BM_ReadResults)->Arg(0)->Arg(1)->ArgName("sax")->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
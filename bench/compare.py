@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Compare a Google Benchmark JSON run against a stored baseline.
+
+Usage:
+    compare.py <baseline.json> <current.json> [--threshold 0.10]
+
+Prints the relative change of real_time for every benchmark present in
+both files and exits with status 1 if any of them got slower than the
+threshold allows.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    results = {}
+    for bench in data.get("benchmarks", []):
+        # При --benchmark_repetitions берём только агрегат mean
+        if bench.get("run_type") == "aggregate" and bench.get("aggregate_name") != "mean":
+            continue
+        name = bench.get("run_name", bench["name"])
+        results[name] = bench
+    return results
+
+
+def to_ns(bench):
+    scale = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}[bench.get("time_unit", "ns")]
+    return bench["real_time"] * scale
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="allowed relative slowdown (default 0.10)")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.baseline):
+        print(f"No baseline at {args.baseline}; record one with the bench_baseline target")
+        return 0
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = []
+    width = max((len(n) for n in current), default=10)
+    print(f"{'benchmark':<{width}}  {'baseline':>12}  {'current':>12}  {'change':>8}")
+    for name, bench in current.items():
+        if name not in baseline:
+            print(f"{name:<{width}}  {'-':>12}  {to_ns(bench):>10.0f}ns  {'new':>8}")
+            continue
+        old = to_ns(baseline[name])
+        new = to_ns(bench)
+        change = (new - old) / old if old > 0 else 0.0
+        mark = ""
+        if change > args.threshold:
+            regressions.append(name)
+            mark = "  <-- regression"
+        print(f"{name:<{width}}  {old:>10.0f}ns  {new:>10.0f}ns  {change:>+7.1%}{mark}")
+
+    for name in baseline:
+        if name not in current:
+            print(f"{name:<{width}}  missing in current run")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than baseline by more than {args.threshold:.0%}")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,52 @@
+#ifndef BOOTSTRAP_H
+#define BOOTSTRAP_H
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+#include "layout.h"
+#include "methods.h"
+
+enum class ResampleMethod
+{
+    Bootstrap, // блочный бутстрэп, перцентильный интервал
+    Jackknife  // исключение по одному блоку, нормальный интервал
+};
+
+struct BootstrapOptions
+{
+    ResampleMethod method = ResampleMethod::Bootstrap;
+    int resamples = 2000;
+    int block_size = 16;     // сторона квадратного блока в пикселях
+    double confidence = 0.95;
+    uint64_t seed = 0;
+};
+
+struct ConfidenceInterval
+{
+    double estimate;
+    double lower;
+    double upper;
+    double std_error;
+};
+
+struct CellConfidence
+{
+    ConfidenceInterval skewness;
+    ConfidenceInterval kurtosis;
+};
+
+// Сводки моментов по блокам block_size x block_size внутри ROI.
+// Ресэмплинг работает только с ними: одна перевыборка стоит O(число блоков),
+// а не повторный проход по пикселям
+std::vector<MomentSummary> blockSummaries(const cv::Mat &image, const std::vector<Span> &spans, int block_size);
+
+// Интервалы по готовым сводкам; stream отделяет последовательности случайных
+// чисел разных ячеек. Результат не зависит от числа потоков. Если блоков
+// меньше двух, границы и стандартная ошибка равны NaN
+CellConfidence resampleCell(const std::vector<MomentSummary> &blocks, const BootstrapOptions &options, uint64_t stream);
+
+// Интервалы для всех ячеек раскладки, в порядке layout.cells
+std::vector<CellConfidence> bootstrapCollage(const cv::Mat &image, const CollageLayout &layout, const BootstrapOptions &options);
+
+#endif
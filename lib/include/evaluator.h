@@ -0,0 +1,81 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+#include "bootstrap.h"
+#include "layout.h"
+#include "storage.h"
+
+using json = nlohmann::json;
+
+// Маска ROI 228x228 в центре каждой ячейки 256x256 сетки rows x cols
+cv::Mat createCollageMask(int rows = 5, int cols = 5);
+json evaluateCollage(const cv::Mat &collage, const cv::Mat &mask);
+
+// Оценка по раскладке (detectCollageLayout/LayoutCache) вместо фиксированной сетки 5x5;
+// многоканальные изображения дают по значению на канал.
+// С approx моменты оцениваются по подвыборке (getApproxMoments), и к ячейкам
+// добавляются стандартные ошибки и число использованных пикселей
+json evaluateCollage(const cv::Mat &collage, const CollageLayout &layout, const ApproxOptions *approx = nullptr);
+
+// Оценка набора статистик (STAT_*) за один проход по каждой ячейке.
+// Асимметрия и эксцесс выводятся всегда, остальные — как evaluated_<имя>.
+// with_sketch добавляет в ячейки поле "sketch" (sketch.h) по одному на канал
+json evaluateCollageStatistics(const cv::Mat &collage, const CollageLayout &layout, unsigned statistics,
+                               bool with_sketch = false);
+
+// Приёмник результатов потоковой оценки: номер ячейки в раскладке и её JSON
+// (можно забрать через std::move). Ячейки приходят по порядку раскладки
+using CellSink = std::function<void(size_t index, json &cell)>;
+
+// Потоковые варианты: ячейки оцениваются блоками и сразу передаются в sink,
+// весь результат в памяти не собирается (gen/eval --ndjson)
+void evaluateCollage(const cv::Mat &collage, const CollageLayout &layout, const ApproxOptions *approx,
+                     const CellSink &sink);
+void evaluateCollageStatistics(const cv::Mat &collage, const CollageLayout &layout, unsigned statistics,
+                               bool with_sketch, const CellSink &sink);
+
+// Параметры eval для одного изображения; общие для командной строки,
+// --batch и запросов к серверу (--connect передаёт их как "args")
+struct EvaluationOptions
+{
+    bool auto_layout = false;
+    std::string layout_key;
+    bool with_intervals = false; // доверительные интервалы ячеек (bootstrap)
+    BootstrapOptions bootstrap;
+    bool with_approx = false;
+    ApproxOptions approx;
+    unsigned statistics = STAT_MOMENTS;
+    bool with_sketch = false;
+    bool ndjson = false; // построчная запись по мере оценки вместо JSON с отступами
+};
+
+// Разбор параметров eval ("--bootstrap", "100", ...); при неизвестном или
+// неверном параметре возвращает false и описание в error
+bool parseEvaluationOptions(const std::vector<std::string> &args, EvaluationOptions &options, std::string &error);
+
+// Всё, кроме ячеек: формат хранения и параметры интервалов. В NDJSON — первая строка
+json evaluationHeader(const StorageInfo &storage, const EvaluationOptions &options);
+
+// Оценка по параметрам: интервалы считаются заранее и добавляются
+// к ячейкам, ячейки по порядку идут в sink. Интервалы (skewness_ci,
+// skewness_se) всегда строятся по всем пикселям, в том числе при --approx,
+// где evaluated_* и skewness_approx_se получены по подвыборке. Интервалы
+// требуют одноканального изображения, иначе std::runtime_error
+void evaluateImage(const cv::Mat &image, const CollageLayout &layout, const EvaluationOptions &options,
+                   const CellSink &sink);
+
+// Заголовок и ячейки одним документом
+json evaluateDocument(const cv::Mat &image, const StorageInfo &storage, const CollageLayout &layout,
+                      const EvaluationOptions &options);
+
+// Запись результата в JSON с отступами или, при options.ndjson, построчно
+// по мере оценки. false, если файл не открылся
+bool writeEvaluation(const std::string &path, const cv::Mat &image, const StorageInfo &storage,
+                     const CollageLayout &layout, const EvaluationOptions &options);
+
+#endif
@@ -5,6 +5,7 @@
 #include <nlohmann/json.hpp>
 #include <vector>
 #include <random>
+#include "storage.h"
 
 using json = nlohmann::json;
 
@@ -16,24 +17,45 @@ struct ElpsParams {
     double angle;
 };
 
+// Сетка коллажа generateAll: строки — средние, столбцы — СКО; ячейка 256x256
+struct GridSpec {
+    std::vector<double> means = {44.0, 88.0, 132.0, 176.0, 220.0};
+    std::vector<double> stddevs = {0.5, 1.0, 1.5, 2.0, 2.5};
+};
+
 class ImageGenerator {
 public:
     ImageGenerator(const std::string& config_path, int seed = -1);
     ImageGenerator(int seed = -1);
+    ImageGenerator(int distribution, double snr_db, int seed);
     static void generate_default_config(const std::string& path);
-    cv::Mat generate_collage(const std::string& gt_path);
+    // Предсказанные моменты для распределений x уровней SNR на сетке grid
+    // без генерации изображений
+    static json predictAll(const std::vector<int>& distributions, const std::vector<double>& snr_levels,
+                           const GridSpec& grid);
+    // ndjson: разметка пишется построчно (results.h) по мере генерации ячеек
+    cv::Mat generate_collage(const std::string& gt_path, bool ndjson = false);
     void generateAll();
 
+    // Чистый коллаж и разметка к нему для произвольной сетки (generateAll — сетка по умолчанию)
+    cv::Mat generateGrid(int distribution, const GridSpec& grid);
+    static json createMetadata(int distribution, double snr_db, const GridSpec& grid = GridSpec());
+
+    cv::Mat applyGaussianNoise(const cv::Mat& image, double snr_db);
+    cv::Mat generate_cell(double mean, double stddev);
+
+    // Формат, в котором generateAll и gen сохраняют коллажи (ключ "storage" конфига)
+    StorageFormat storageFormat() const { return storage; }
+    void setStorageFormat(StorageFormat format) { storage = format; }
+
 private:
     int distribution;
     double snr_db;
     unsigned int seed;
+    StorageFormat storage = StorageFormat::Float32;
     std::mt19937 rng;
 
     void parseConfig(const json& config);
-    cv::Mat applyGaussianNoise(const cv::Mat& image, double snr_db);
-    cv::Mat generate_cell(double mean, double stddev);
-    json createMetadata(int distribution, double snr_db);
     cv::Mat generateCollage1(int distribution);
     cv::Mat generate_cell1(int distribution, double mean, double stddev);
 };
@@ -0,0 +1,78 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <opencv2/opencv.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "methods.h"
+
+// ROI одной ячейки коллажа в виде списка отрезков строк
+struct CellRoi
+{
+    int row;
+    int col;
+    cv::Rect bbox;
+    std::vector<Span> spans;
+};
+
+// Раскладка коллажа: размер изображения и ячейки, упорядоченные по (row, col)
+struct CollageLayout
+{
+    cv::Size size;
+    std::vector<CellRoi> cells;
+};
+
+struct DetectionParams
+{
+    int blur_size = 15;           // окно сглаживания шума перед порогом
+    double threshold_sigma = 4.0; // грубый порог в единицах СКО фона
+    int min_area = 256;           // меньшие компоненты считаются шумом
+    int inset = 2;                // отступ внутрь от найденной границы ROI
+};
+
+// Раскладка по готовой маске (например, createCollageMask)
+CollageLayout layoutFromMask(const cv::Mat &mask, int min_area = 1);
+
+// Поиск ROI по самому изображению: уровень фона оценивается по рамке,
+// ячейки выделяются связными компонентами на сглаженном изображении
+CollageLayout detectCollageLayout(const cv::Mat &image, const DetectionParams &params = DetectionParams());
+
+// Подпись раскладки: размер и тип изображения плюс необязательный ключ
+// набора данных (нужен, если разные раскладки совпадают по размеру)
+std::string layoutSignature(const cv::Mat &image, const std::string &key = "");
+
+// Согласуется ли раскладка с изображением: по уменьшенной копии проверяется,
+// что внутренности ячеек отличаются от фона, а промежутки между ними — нет
+bool layoutMatchesImage(const cv::Mat &image, const CollageLayout &layout,
+                        const DetectionParams &params = DetectionParams());
+
+// Кэш раскладок: детектирование выполняется один раз на подпись, пока
+// найденная раскладка согласуется с новыми изображениями (layoutMatchesImage).
+// Сверка идёт без замка; детектирования разных подписей не ждут друг друга
+class LayoutCache
+{
+public:
+    explicit LayoutCache(const DetectionParams &params = DetectionParams());
+    std::shared_ptr<const CollageLayout> get(const cv::Mat &image, const std::string &key = "");
+    size_t size() const;
+
+private:
+    // Раскладки одной подписи; detect_mutex упорядочивает только детектирование
+    // этой подписи, список layouts защищён общим mutex
+    struct Entry
+    {
+        std::mutex detect_mutex;
+        std::vector<std::shared_ptr<const CollageLayout>> layouts;
+    };
+
+    std::vector<std::shared_ptr<const CollageLayout>> snapshot(Entry &entry, size_t from) const;
+
+    DetectionParams params;
+    mutable std::mutex mutex;
+    std::map<std::string, std::shared_ptr<Entry>> entries;
+};
+
+#endif
@@ -2,10 +2,134 @@
 #define METHODS_H
 
 #include <opencv2/opencv.hpp>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <string>
+#include <vector>
+
+// Отрезок строки [x0, x1) в строке y — компактное описание маски
+struct Span {
+    int y;
+    int x0;
+    int x1;
+};
 
 double getSkewnessValue(const cv::Mat& image, const cv::Mat& mask);
 double getKurtosisValue(const cv::Mat& image, const cv::Mat& mask);
 
+// То же по списку отрезков вместо маски (image CV_32FC1)
+double getSkewnessValue(const cv::Mat& image, const std::vector<Span>& spans);
+double getKurtosisValue(const cv::Mat& image, const std::vector<Span>& spans);
+
+std::vector<Span> maskToSpans(const cv::Mat& mask);
+
+// Центральные моменты выборки; части выборки объединяются через merge
+// (формулы Pébay), поэтому их можно считать независимо
+struct MomentSummary {
+    double n = 0.0;
+    double mean = 0.0;
+    double M2 = 0.0; // сумма (x-μ)^2
+    double M3 = 0.0;
+    double M4 = 0.0;
+
+    void merge(const MomentSummary& other);
+    double skewness() const; // как getSkewnessValue
+    double kurtosis() const; // избыточный, как getKurtosisValue
+};
+
+// Моменты всех каналов (1-4, глубина 8U/16U/16S/16F/32F/64F) за один проход
+// по чередующимся данным; по одному элементу на канал
+std::vector<MomentSummary> getChannelMoments(const cv::Mat& image, const std::vector<Span>& spans);
+std::vector<MomentSummary> getChannelMoments(const cv::Mat& image, const cv::Mat& mask);
+
+// Гистограмма с шириной корзины 2^exponent и границами, кратными ширине.
+// Диапазон растёт укрупнением корзин вдвое, поэтому любые две гистограммы
+// приводятся к общей сетке и объединяются через merge
+struct HistogramSketch {
+    static constexpr int BINS = 2048;
+    static constexpr int MIN_EXPONENT = -64;  // ширина корзины не меньше 2^-64
+    static constexpr int MAX_EXPONENT = 1000; // 2^-exponent остаётся нормальным числом
+
+    int exponent = 0;
+    long long origin = 0;       // номер первой корзины в единицах ширины
+    double inv_width = 1.0;     // 2^-exponent
+    std::vector<double> counts; // пусто, пока значений нет
+
+    bool empty() const { return counts.empty(); }
+    double binWidth() const { return std::ldexp(1.0, exponent); }
+    double total() const;
+
+    // Расширение диапазона до [lo, hi]; после него add не выходит за границы
+    void ensureRange(double lo, double hi);
+    void add(double x, double weight = 1.0);
+    void merge(const HistogramSketch& other);
+    // Укрупнение, пока непустые корзины не уложатся в max_bins подряд
+    void reduce(int max_bins);
+
+    // Квантиль с линейной интерполяцией внутри корзины
+    double quantile(double p) const;
+};
+
+// Набор статистик ячейки (битовая маска)
+enum StatisticFlags : unsigned {
+    STAT_SKEWNESS = 1u << 0,
+    STAT_KURTOSIS = 1u << 1,
+    STAT_BOWLEY = 1u << 2,      // квартильная асимметрия
+    STAT_MEDCOUPLE = 1u << 3,
+    STAT_L_SKEWNESS = 1u << 4,  // tau3 = lambda3 / lambda2
+    STAT_L_KURTOSIS = 1u << 5,  // tau4 = lambda4 / lambda2
+};
+
+constexpr unsigned STAT_MOMENTS = STAT_SKEWNESS | STAT_KURTOSIS;
+constexpr unsigned STAT_ALL = STAT_MOMENTS | STAT_BOWLEY | STAT_MEDCOUPLE | STAT_L_SKEWNESS | STAT_L_KURTOSIS;
+
+// Список через запятую: skewness,kurtosis,bowley,medcouple,l_skewness,l_kurtosis или all
+bool parseStatistics(const std::string& list, unsigned& statistics);
+std::string statisticName(StatisticFlags statistic);
+
+// Общая сводка ячейки: степенные суммы и гистограмма собираются за один
+// проход, все статистики выводятся из них без повторного чтения пикселей
+struct CellStatistics {
+    MomentSummary moments;
+    HistogramSketch histogram; // пустая, если квантильные статистики не нужны
+
+    void merge(const CellStatistics& other);
+    double value(StatisticFlags statistic) const;
+};
+
+// Как getChannelMoments; гистограмма строится, только если statistics
+// содержит что-то кроме STAT_MOMENTS
+std::vector<CellStatistics> getChannelStatistics(const cv::Mat& image, const std::vector<Span>& spans, unsigned statistics);
+
+// Пакет из N изображений одного размера с общей раскладкой ячеек.
+// Результат — тензор N x C x cells типа CV_64FC2: (асимметрия, эксцесс)
+cv::Mat getBatchMoments(const std::vector<cv::Mat>& images, const std::vector<std::vector<Span>>& cells);
+// batch — 3D Mat размера N x H x W с любым числом каналов
+cv::Mat getBatchMoments(const cv::Mat& batch, const std::vector<std::vector<Span>>& cells);
+
+// Приближённые моменты по стратифицированной подвыборке пикселей
+struct ApproxOptions {
+    double tolerance = 0.05;       // допустимая стандартная ошибка асимметрии и эксцесса
+    double initial_fraction = 0.01; // начальная доля пикселей
+    double max_fraction = 0.05;    // предел роста подвыборки
+    int groups = 16;               // независимые подгруппы для оценки ошибки
+    uint64_t seed = 0;
+};
+
+struct ApproxMoments {
+    double skewness;
+    double kurtosis;
+    double skewness_error; // стандартная ошибка оценки
+    double kurtosis_error;
+    long long samples;     // число использованных пикселей
+    bool converged;        // ошибки не превышают tolerance
+};
+
+// Подвыборка удваивается, пока ошибки больше tolerance и не достигнут
+// max_fraction. Если нужная доля не меньше всей ROI, считается точно.
+// samples не превышает max_fraction ROI, кроме минимума в один пиксель на подгруппу
+ApproxMoments getApproxMoments(const cv::Mat& image, const std::vector<Span>& spans, const ApproxOptions& options);
+ApproxMoments getApproxMoments(const cv::Mat& image, const cv::Mat& mask, const ApproxOptions& options);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,48 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include <vector>
+
+// Предсказание асимметрии и эксцесса зашумлённого сигнала без генерации
+// изображений. Кумулянты независимых слагаемых складываются, а у гауссова
+// шума ненулевой только второй кумулянт:
+//   skew = k3 / (k2 + sn^2)^1.5,  kurt = k4 / (k2 + sn^2)^2
+
+struct Cumulants
+{
+    double k2;
+    double k3;
+    double k4;
+};
+
+struct PredictedMoments
+{
+    double skewness;
+    double kurtosis; // избыточный
+};
+
+struct CellSpec
+{
+    double mean;
+    double stddev;
+};
+
+// Кумулянты распределения ячейки с параметрами как у generate_cell:
+// 0 — нормальное, 1 — равномерное, 2 — экспоненциальное со средним mean
+Cumulants signalCumulants(int distribution, double mean, double stddev);
+
+// СКО шума при мощности сигнала signal_variance и заданном SNR
+double noiseStddev(double signal_variance, double snr_db);
+
+PredictedMoments predictNoisyMoments(const Cumulants &signal, double noise_stddev);
+
+// Модель generate_cell: шум считается по stddev самой ячейки
+PredictedMoments predictCellMoments(int distribution, double mean, double stddev, double snr_db);
+
+// Модель generateAll/applyGaussianNoise: шум считается по дисперсии всего
+// чистого коллажа, включая нулевой фон. roi_fraction — доля пикселей
+// изображения, занятая ROI одной ячейки
+std::vector<PredictedMoments> predictCollageMoments(int distribution, double snr_db,
+                                                    const std::vector<CellSpec> &cells, double roi_fraction);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+// Отчёт без окон: графики рисуются в память, пишутся в PNG или SVG,
+// а index.html собирает их на одной странице
+
+struct ReportSeries
+{
+    std::string label;
+    cv::Scalar color; // BGR, как в остальном коде OpenCV
+    std::vector<double> x;
+    std::vector<double> y;
+};
+
+struct ReportPlot
+{
+    std::string name;    // имя файла без расширения
+    std::string section; // заголовок раздела в index.html
+    std::string title;
+    std::string x_label;
+    std::string y_label;
+    std::vector<ReportSeries> series;
+};
+
+enum class ReportFormat
+{
+    Png,
+    Svg
+};
+
+struct ReportOptions
+{
+    std::string directory;
+    ReportFormat format = ReportFormat::Png;
+    int width = 1200;
+    int height = 800;
+};
+
+bool parseReportFormat(const std::string &name, ReportFormat &format);
+
+// Цвет i-й серии из фиксированной палитры
+cv::Scalar seriesColor(size_t index);
+
+cv::Mat renderPlot(const ReportPlot &plot, int width, int height);
+std::string renderPlotSvg(const ReportPlot &plot, int width, int height);
+
+// Все графики рисуются параллельно (cv::parallel_for_), ошибка одного
+// графика не останавливает остальные и отмечается в index.html.
+// Возвращает число записанных файлов
+int writeReport(const std::vector<ReportPlot> &plots, const ReportOptions &options);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <nlohmann/json.hpp>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <string>
+
+using json = nlohmann::json;
+
+// Потоковый формат результатов (gen/eval --ndjson): первая строка —
+// заголовок без ячеек, далее по одной ячейке на строку с полями row и column.
+// Строки пишутся по мере готовности, документ целиком в памяти не собирается
+class NdjsonWriter
+{
+public:
+    explicit NdjsonWriter(const std::string &path);
+
+    bool isOpen() const { return out.is_open(); }
+    void write(const json &line);
+
+private:
+    std::ofstream out;
+};
+
+// Поля ячейки, нужные для сравнения с gt; отсутствующие остаются NaN
+struct CellRecord
+{
+    int row = -1;
+    int column = -1;
+    double evaluated_skewness = NAN;
+    double evaluated_kurtosis = NAN;
+    double theoretical_skewness = NAN;
+    double theoretical_kurtosis = NAN;
+    double predicted_skewness = NAN;
+    double predicted_kurtosis = NAN;
+    double mean = NAN;
+    double stddev = NAN;
+    double skewness_ci[2] = {NAN, NAN};
+    double kurtosis_ci[2] = {NAN, NAN};
+};
+
+// Ячейка из готового DOM; row и column, если их нет в самой ячейке
+// (gt: cells[row][col]), передаются явно
+CellRecord cellRecordFromJson(const json &cell, int row = -1, int column = -1);
+
+// SAX-чтение файла результатов без построения DOM. Понимает eval
+// ({"cells": [{...}]}), gt ({"cells": [[{...}]]}) и NDJSON; многоканальные
+// значения (массивы) пропускаются. cell вызывается для каждой ячейки по порядку.
+// Возвращает false, если файл не открылся или разбор прерван ошибкой
+bool readCellRecords(const std::string &path, const std::function<void(const CellRecord &)> &cell);
+
+// Документ целиком (DOM) для тех, кому нужны все поля (ass --pool).
+// NDJSON (по расширению .ndjson или по содержимому) собирается в
+// {<поля заголовка>, "cells": [<строки>]}
+json readResultDocument(const std::string &path);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include "stream.h"
+
+using json = nlohmann::json;
+
+// Долгоживущий режим оценки: маски, раскладки и пул потоков OpenCV
+// создаются один раз, запросы приходят через Unix-сокет.
+//
+// Протокол — по одному JSON-объекту на строку в обе стороны:
+//   {"id": 1, "image": "path.tiff", "output": "eval.json"}
+//   {"id": 2, "shm": "/frame0", "width": 1280, "height": 1280, "type": "f32",
+//    "offset": 0, "layout": "auto", "layout_key": "set1"}
+//   {"command": "ping" | "stats" | "shutdown"}
+// layout: "fixed" (по умолчанию, сетка createCollageMask), "auto"
+// (detectCollageLayout с кэшем) или массив {row, col, x, y, width, height}.
+// "args" — параметры eval списком строк (["--bootstrap", "200", "--ndjson"]),
+// разбираются parseEvaluationOptions; необязательный "approx" — краткая форма --approx.
+// Ответ: {"id", "ok", "cells", "latency_us"} и поля заголовка eval (storage,
+// confidence, resampling); с "output" — {"id", "ok", "cells": <число>, "output",
+// "latency_us"}, ячейки только в файле; при ошибке {"id", "ok": false, "error"}.
+// Строка запроса длиннее 4 МиБ закрывает соединение
+struct ServerOptions
+{
+    std::string socket_path;
+    int backlog = 64;
+};
+
+struct ServerStats
+{
+    long long requests = 0;
+    long long errors = 0;
+    long long clients = 0;
+    LatencyHistogram latency;
+
+    json toJson() const;
+};
+
+// Обслуживает клиентов (по потоку на соединение) до команды shutdown
+// или requestServerStop()
+ServerStats runEvalServer(const ServerOptions &options);
+
+// Остановка сервера; безопасна в обработчике сигнала
+void requestServerStop();
+
+// Клиент: один запрос и ответ на него
+json sendServerRequest(const std::string &socket_path, const json &request);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <nlohmann/json.hpp>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "methods.h"
+
+using json = nlohmann::json;
+
+// Сводки ячеек на диске: степенные моменты и гистограмма, укрупнённая
+// до SKETCH_BINS корзин. Сводки разных изображений объединяются без
+// повторного чтения пикселей. Формат одного канала:
+//   {"n", "mean", "m2", "m3", "m4", "exponent", "first", "counts": [...]}
+// где counts — корзины first, first+1, ... шириной 2^exponent
+constexpr int SKETCH_BINS = 256;
+
+json sketchToJson(const CellStatistics &statistics, int max_bins = SKETCH_BINS);
+CellStatistics sketchFromJson(const json &sketch);
+
+// Объединённые сводки ячеек нескольких оценок; ячейки сопоставляются
+// по (row, column), каналы — по порядку
+struct SketchPool
+{
+    std::map<std::pair<int, int>, std::vector<CellStatistics>> cells;
+    int evaluations = 0;
+
+    // evaluation — результат eval с полем "sketch" в ячейках;
+    // возвращает число добавленных ячеек (0, если сводок нет)
+    int add(const json &evaluation);
+
+    // {"evaluations", "cells": [{"row", "column", "n", "pooled_<статистика>"}]};
+    // квантильные статистики только при наличии гистограмм
+    json toJson(unsigned statistics = STAT_ALL) const;
+};
+
+#endif
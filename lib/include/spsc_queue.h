@@ -0,0 +1,61 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Ограниченная lock-free очередь на один производитель и один потребитель.
+// Ёмкость округляется вверх до степени двойки.
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    // Вызывается только производителем; false, если очередь заполнена
+    bool tryPush(T &&value)
+    {
+        const size_t tail = write_index.load(std::memory_order_relaxed);
+        if (tail - read_index.load(std::memory_order_acquire) > mask)
+            return false;
+        slots[tail & mask] = std::move(value);
+        write_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Вызывается только потребителем
+    std::optional<T> tryPop()
+    {
+        const size_t head = read_index.load(std::memory_order_relaxed);
+        if (head == write_index.load(std::memory_order_acquire))
+            return std::nullopt;
+        T value = std::move(slots[head & mask]);
+        read_index.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    size_t size() const
+    {
+        return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    std::vector<T> slots;
+    size_t mask;
+    // Индексы на разных кэш-линиях, чтобы потоки не делили линию
+    alignas(64) std::atomic<size_t> write_index{0};
+    alignas(64) std::atomic<size_t> read_index{0};
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <string>
+#include "layout.h"
+
+using json = nlohmann::json;
+
+// Формат хранения коллажа на диске. Компактные форматы занимают вдвое
+// меньше места, чем float32, и сопровождаются файлом метаданных
+enum class StorageFormat
+{
+    Float32,  // исходный CV_32F, без метаданных
+    Float16,  // половинная точность; в TIFF пишется битовый образ в 16U
+    Scaled16  // 16-битные целые: value = stored * scale + offset
+};
+
+struct StorageInfo
+{
+    StorageFormat format = StorageFormat::Float32;
+    double scale = 1.0;
+    double offset = 0.0;
+};
+
+bool parseStorageFormat(const std::string &name, StorageFormat &format);
+std::string storageFormatName(StorageFormat format);
+
+// Метаданные лежат рядом с изображением: <image_path>.json
+std::string storageSidecarPath(const std::string &image_path);
+
+// Кодирование CV_32F в выбранный формат. Для Float16 результат имеет тип CV_16F
+cv::Mat encodeCollage(const cv::Mat &collage, StorageFormat format, StorageInfo &info);
+
+// Запись коллажа с метаданными. При заданной раскладке в метаданные
+// добавляется ошибка моментов относительно float32 (storageMomentError).
+// Возвращает записанные метаданные (пустой объект для Float32; прежний
+// файл метаданных при этом удаляется)
+json writeCollage(const std::string &path, const cv::Mat &collage, StorageFormat format,
+                  const CollageLayout *layout = nullptr);
+
+// Чтение коллажа в компактном виде, без декодирования в float32:
+// Float16 возвращается как CV_16F, Scaled16 — как CV_16U. Асимметрия и эксцесс
+// не меняются при положительном аффинном преобразовании, поэтому scale и offset
+// для оценки моментов не нужны. Метаданные, не совпадающие с глубиной
+// изображения, игнорируются
+cv::Mat readStoredCollage(const std::string &path, StorageInfo &info);
+
+// Ошибка асимметрии и эксцесса, внесённая хранением: моменты ячеек stored
+// сравниваются с моментами исходного float32
+json storageMomentError(const cv::Mat &original, const cv::Mat &stored, const CollageLayout &layout);
+
+#endif
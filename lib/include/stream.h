@@ -0,0 +1,68 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+using json = nlohmann::json;
+
+// Что делать, когда вычисление не успевает за источником кадров
+enum class OverflowPolicy
+{
+    Block,  // источник ждёт освобождения очереди (backpressure)
+    Drop,   // новый кадр отбрасывается, если очередь заполнена
+    Latest  // обработчик пропускает накопившиеся кадры и берёт самый свежий
+};
+
+struct StreamOptions
+{
+    std::string source;            // видеофайл, номер камеры, шаблон "img_%04d.tiff", каталог или "-" (stdin)
+    cv::Size raw_size;             // размер кадра для stdin
+    int raw_type = CV_32FC1;       // тип пикселя для stdin
+    size_t queue_capacity = 8;
+    OverflowPolicy policy = OverflowPolicy::Block;
+    bool auto_layout = false;
+    std::string layout_key;
+    long long max_frames = -1;     // -1 — до конца источника
+};
+
+// Гистограмма задержек по степеням двойки в микросекундах
+class LatencyHistogram
+{
+public:
+    void add(int64_t latency_ns);
+    double percentileUs(double p) const;
+    json toJson() const;
+
+private:
+    static constexpr int BUCKETS = 40;
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    int64_t max_ns = 0;
+};
+
+struct StreamStats
+{
+    long long frames_read = 0;
+    long long frames_processed = 0;
+    long long frames_dropped = 0;    // только из-за переполнения очереди (Drop, Latest)
+    long long frames_wrong_size = 0; // кадры не того размера для фиксированной сетки
+    long long frames_failed = 0;     // оценка кадра завершилась ошибкой OpenCV
+    LatencyHistogram latency;
+    std::string error;               // непустая, если поток оборвался из-за ошибки
+};
+
+bool parseOverflowPolicy(const std::string &name, OverflowPolicy &policy);
+
+// Чтение кадров, оценка асимметрии и эксцесса по ROI и вывод NDJSON
+// (одна строка на кадр) в out. Источник, вычисление и вывод работают
+// в отдельных потоках, связанных ограниченными lock-free очередями.
+// Исключение в потоке чтения или вычисления завершает поток кадров:
+// последней строкой выводится {"error": ...}, текст попадает в StreamStats::error
+StreamStats runFrameStream(const StreamOptions &options, std::ostream &out);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+#include "generator.h"
+#include "storage.h"
+
+using json = nlohmann::json;
+
+// Описание прогона: распределения x SNR x зёрна на заданной сетке.
+// Пример манифеста:
+//   {"name": "seeds", "distributions": [0, 1, 2], "snr_db": [0, 10, 20],
+//    "seeds": [1, 2, 3], "grid": {"means": [...], "stddevs": [...]},
+//    "storage": "float16", "keep_images": false, "auto_layout": false, "approx": 0.05,
+//    "sketch": true}
+struct SweepManifest
+{
+    std::string name;
+    std::vector<int> distributions = {0, 1, 2};
+    std::vector<double> snr_levels = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
+    std::vector<int> seeds = {0};
+    GridSpec grid;
+    StorageFormat storage = StorageFormat::Float32;
+    bool keep_images = true;  // сохранять зашумлённые коллажи в <dir>/images
+    bool auto_layout = false; // detectCollageLayout вместо сетки createCollageMask
+    double approx = 0.0;      // допуск getApproxMoments; 0 — точная оценка
+    bool sketch = false;      // сводки ячеек (sketch.h) для объединения в ass --pool
+};
+
+SweepManifest parseSweepManifest(const json &manifest);
+
+// Единица работы — одно распределение с одним зерном: чистый коллаж
+// генерируется один раз и используется для всех уровней SNR
+struct SweepItem
+{
+    int distribution;
+    int seed;
+};
+
+std::string sweepItemId(const SweepItem &item);
+
+// Очередь на диске (каталоги внутри sweep_dir):
+//   queue/pending -> queue/claimed -> queue/done  — переходы атомарным rename
+//                                                  (в claimed — <id>~<worker>.json),
+//   results/<id>.json                            — результаты элемента (shard)
+// Захваченный элемент, который владелец не обновлял дольше lease,
+// возвращается в pending (упавший процесс или потерянный хост). Пока элемент
+// в работе, фоновый поток обновляет время файла каждые lease/4
+struct SweepStatus
+{
+    int pending = 0;
+    int claimed = 0;
+    int done = 0;
+};
+
+struct SweepWorkerOptions
+{
+    std::string worker_id;   // по умолчанию host:pid
+    int lease_seconds = 600;
+    int poll_ms = 1000;
+    int max_items = -1;      // -1 — пока очередь не опустеет
+};
+
+// Создаёт каталоги, копирует манифест и ставит в очередь недостающие элементы.
+// Повторный вызов не трогает уже взятые и завершённые. Возвращает число новых
+int initSweep(const std::string &manifest_path, const std::string &sweep_dir);
+
+SweepStatus sweepStatus(const std::string &sweep_dir);
+
+// Возврат просроченных элементов в pending; возвращает их число
+int reclaimStaleItems(const std::string &sweep_dir, int lease_seconds);
+
+// Генерация, оценка и запись shard одного элемента. Возвращает false, если
+// файл захвата claim_path исчез (элемент забран как просроченный) и shard не записан
+bool runSweepItem(const SweepManifest &manifest, const std::string &sweep_dir, const SweepItem &item,
+                  const std::string &claim_path);
+
+// Цикл рабочего процесса; возвращает число обработанных элементов
+int runSweepWorker(const std::string &sweep_dir, const SweepWorkerOptions &options);
+
+// Все записи shard'ов: {distribution, snr_db, seed, gt, evaluation}
+std::vector<json> loadSweepResults(const std::string &sweep_dir);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Лёгкая трассировка этапов: scoped-таймеры и счётчики.
+// При сборке без VISION_TRACE макросы раскрываются в пустоту.
+// Запись включается во время выполнения переменной окружения
+// VISION_TRACE=<путь к trace.json>; без неё таймер стоит одну проверку флага.
+// Результат открывается в chrome://tracing или ui.perfetto.dev.
+// Имена событий должны быть строковыми литералами: хранится только указатель.
+
+#ifdef VISION_TRACE
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace trace
+{
+    bool enabled();
+    int64_t nowNs();
+    void recordSpan(const char *name, int64_t start_ns, int64_t end_ns);
+    void recordCounter(const char *name, double value);
+
+    // Выгружает буферы потоков в trace-файл и печатает сводную таблицу
+    // за всё время работы. Буфер потока выгружается и сам, когда переполнен
+    void printSummary(std::ostream &out);
+    // Сбрасывает всё накопленное, если трассировка включена; буферы при этом
+    // очищаются, и повторный вызов дописывает файл только новыми событиями
+    void flush();
+
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(const char *name)
+            : name(name), start(enabled() ? nowNs() : -1) {}
+        ~ScopedTimer()
+        {
+            if (start >= 0)
+                recordSpan(name, start, nowNs());
+        }
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        const char *name;
+        int64_t start;
+    };
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(name) trace::ScopedTimer TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value)                   \
+    do                                               \
+    {                                                \
+        if (trace::enabled())                        \
+            trace::recordCounter(name, (value));     \
+    } while (0)
+#define TRACE_FLUSH() trace::flush()
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+#define TRACE_FLUSH() ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,165 @@
+#include "bootstrap.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+
+// Перемешивание splitmix64: из (seed, ячейка, номер перевыборки) получается
+// независимое начальное состояние генератора
+static uint64_t mixSeed(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Квантиль стандартного нормального распределения (бисекция по erfc)
+static double normalQuantile(double p)
+{
+    double lo = -10.0, hi = 10.0;
+    for (int i = 0; i < 100; i++)
+    {
+        double mid = (lo + hi) / 2;
+        if (0.5 * std::erfc(-mid / std::sqrt(2.0)) < p)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+// Перцентиль по отсортированному вектору с линейной интерполяцией
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    const double pos = p * (sorted.size() - 1);
+    const size_t i = static_cast<size_t>(pos);
+    if (i + 1 >= sorted.size())
+        return sorted.back();
+    return sorted[i] + (pos - i) * (sorted[i + 1] - sorted[i]);
+}
+
+static double stdDev(const std::vector<double> &values)
+{
+    double mean = 0.0;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    double sum2 = 0.0;
+    for (double v : values)
+        sum2 += (v - mean) * (v - mean);
+    return std::sqrt(sum2 / std::max<size_t>(values.size() - 1, 1));
+}
+
+std::vector<MomentSummary> blockSummaries(const cv::Mat &image, const std::vector<Span> &spans, int block_size)
+{
+    CV_Assert(image.channels() == 1 && block_size > 0);
+
+    // Отрезки режутся по границам блоков; каждый кусок — один вызов getChannelMoments
+    std::map<std::pair<int, int>, std::vector<Span>> pieces;
+    for (const Span &s : spans)
+    {
+        for (int x0 = s.x0; x0 < s.x1;)
+        {
+            int bx = x0 / block_size;
+            int x1 = std::min(s.x1, (bx + 1) * block_size);
+            pieces[{s.y / block_size, bx}].push_back({s.y, x0, x1});
+            x0 = x1;
+        }
+    }
+
+    std::vector<MomentSummary> blocks;
+    blocks.reserve(pieces.size());
+    for (const auto &[key, block_spans] : pieces)
+        blocks.push_back(getChannelMoments(image, block_spans)[0]);
+    return blocks;
+}
+
+CellConfidence resampleCell(const std::vector<MomentSummary> &blocks, const BootstrapOptions &options, uint64_t stream)
+{
+    const int n_blocks = static_cast<int>(blocks.size());
+
+    MomentSummary total;
+    for (const MomentSummary &b : blocks)
+        total.merge(b);
+
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    CellConfidence result;
+    result.skewness = {total.skewness(), nan, nan, nan};
+    result.kurtosis = {total.kurtosis(), nan, nan, nan};
+
+    // Из одного блока разброс не оценить: интервалы остаются NaN
+    if (n_blocks < 2 || options.resamples < 2)
+        return result;
+
+    std::vector<double> skew, kurt;
+
+    if (options.method == ResampleMethod::Jackknife)
+    {
+        // Сводки без i-го блока: префикс [0, i) объединяется с суффиксом (i, n)
+        std::vector<MomentSummary> suffix(n_blocks + 1);
+        for (int i = n_blocks - 1; i >= 0; i--)
+        {
+            suffix[i] = blocks[i];
+            suffix[i].merge(suffix[i + 1]);
+        }
+        MomentSummary prefix;
+        for (int i = 0; i < n_blocks; i++)
+        {
+            MomentSummary without = prefix;
+            without.merge(suffix[i + 1]);
+            skew.push_back(without.skewness());
+            kurt.push_back(without.kurtosis());
+            prefix.merge(blocks[i]);
+        }
+
+        const double z = normalQuantile(0.5 + options.confidence / 2);
+        const double scale = (n_blocks - 1) / std::sqrt(static_cast<double>(n_blocks));
+        for (auto [ci, values] : {std::pair{&result.skewness, &skew}, std::pair{&result.kurtosis, &kurt}})
+        {
+            ci->std_error = stdDev(*values) * scale;
+            ci->lower = ci->estimate - z * ci->std_error;
+            ci->upper = ci->estimate + z * ci->std_error;
+        }
+        return result;
+    }
+
+    skew.resize(options.resamples);
+    kurt.resize(options.resamples);
+    cv::parallel_for_(cv::Range(0, options.resamples), [&](const cv::Range &range)
+                      {
+        for (int r = range.start; r < range.end; r++)
+        {
+            cv::RNG rng(mixSeed(options.seed ^ mixSeed(stream ^ mixSeed(static_cast<uint64_t>(r)))));
+            MomentSummary sample;
+            for (int i = 0; i < n_blocks; i++)
+                sample.merge(blocks[rng.uniform(0, n_blocks)]);
+            skew[r] = sample.skewness();
+            kurt[r] = sample.kurtosis();
+        } });
+
+    const double alpha = 1.0 - options.confidence;
+    for (auto [ci, values] : {std::pair{&result.skewness, &skew}, std::pair{&result.kurtosis, &kurt}})
+    {
+        ci->std_error = stdDev(*values);
+        std::sort(values->begin(), values->end());
+        ci->lower = percentile(*values, alpha / 2);
+        ci->upper = percentile(*values, 1.0 - alpha / 2);
+    }
+    return result;
+}
+
+std::vector<CellConfidence> bootstrapCollage(const cv::Mat &image, const CollageLayout &layout, const BootstrapOptions &options)
+{
+    TRACE_SCOPE("bootstrap.collage");
+    std::vector<CellConfidence> result;
+    result.reserve(layout.cells.size());
+    for (const CellRoi &cell : layout.cells)
+    {
+        std::vector<MomentSummary> blocks = blockSummaries(image, cell.spans, options.block_size);
+        const uint64_t stream = (static_cast<uint64_t>(cell.row) << 32) | static_cast<uint32_t>(cell.col);
+        result.push_back(resampleCell(blocks, options, stream));
+    }
+    return result;
+}
@@ -0,0 +1,395 @@
+#include "evaluator.h"
+#include "methods.h"
+#include "results.h"
+#include "sketch.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+cv::Mat createCollageMask(int rows, int cols)
+{
+    const int cell_size = 256;
+    const int roi_size = 228;
+    const int border = (cell_size - roi_size) / 2; // (256-228)/2 = 14
+
+    cv::Mat mask(rows * cell_size, cols * cell_size, CV_8UC1, cv::Scalar(0));
+
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < cols; col++)
+        {
+            // Координаты ROI внутри ячейки
+            int x_start = col * cell_size + border;
+            int y_start = row * cell_size + border;
+
+            // Создаем белый квадрат ROI
+            cv::Rect roi_rect(x_start, y_start, roi_size, roi_size);
+            mask(roi_rect).setTo(cv::Scalar(255));
+        }
+    }
+    return mask;
+}
+
+json evaluateCollage(const cv::Mat &collage, const cv::Mat &mask)
+{
+    json j_result;
+    std::vector<json> cells_array;
+
+    const int cell_size = 256;
+    const int roi_size = 228;
+    const int border = (cell_size - roi_size) / 2;
+
+    // Размер сетки берётся из маски (createCollageMask(rows, cols))
+    const int rows = mask.rows / cell_size;
+    const int cols = mask.cols / cell_size;
+
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < cols; col++)
+        {
+            // Координаты ячейки
+            cv::Rect cell_rect(col * cell_size, row * cell_size, cell_size, cell_size);
+
+            // Координаты ROI внутри ячейки
+            cv::Rect roi_rect(
+                col * cell_size + border,
+                row * cell_size + border,
+                roi_size,
+                roi_size);
+
+            // Создаем маску для текущей ячейки
+            cv::Mat cell_mask = mask(roi_rect).clone();
+
+            // Вырезаем ROI изображения
+            cv::Mat cell_roi = collage(roi_rect);
+
+            // Преобразуем в float для вычислений
+            cv::Mat cell_float;
+            {
+                TRACE_SCOPE("eval.convertTo");
+                cell_roi.convertTo(cell_float, CV_32F);
+            }
+
+            // Вычисляем статистики
+            double skewness = getSkewnessValue(cell_float, cell_mask);
+            double kurtosis = getKurtosisValue(cell_float, cell_mask);
+
+            // Добавляем в JSON
+            json j_cell;
+            j_cell["row"] = row;
+            j_cell["column"] = col;
+            j_cell["evaluated_skewness"] = skewness;
+            j_cell["evaluated_kurtosis"] = kurtosis;
+
+            cells_array.push_back(j_cell);
+        }
+    }
+
+    j_result["cells"] = cells_array;
+    TRACE_COUNTER("eval.cells", static_cast<double>(cells_array.size()));
+    return j_result;
+}
+
+namespace
+{
+    // Ячейки обрабатываются блоками: внутри блока параллельно, между
+    // блоками результат передаётся в sink, так что память ограничена блоком
+    constexpr int CELL_BLOCK = 1024;
+
+    json evaluateCell(const cv::Mat &collage, const CellRoi &cell, const ApproxOptions *approx)
+    {
+        json j_cell;
+        j_cell["row"] = cell.row;
+        j_cell["column"] = cell.col;
+
+        if (approx)
+        {
+            ApproxMoments m = getApproxMoments(collage, cell.spans, *approx);
+            j_cell["evaluated_skewness"] = m.skewness;
+            j_cell["evaluated_kurtosis"] = m.kurtosis;
+            j_cell["skewness_approx_se"] = m.skewness_error;
+            j_cell["kurtosis_approx_se"] = m.kurtosis_error;
+            j_cell["samples"] = m.samples;
+            j_cell["converged"] = m.converged;
+            return j_cell;
+        }
+
+        // Один проход по исходным данным без приведения к float; для
+        // многоканальных изображений значения выводятся массивом по каналам
+        std::vector<MomentSummary> moments = getChannelMoments(collage, cell.spans);
+        if (moments.size() == 1)
+        {
+            j_cell["evaluated_skewness"] = moments[0].skewness();
+            j_cell["evaluated_kurtosis"] = moments[0].kurtosis();
+        }
+        else
+        {
+            for (const MomentSummary &m : moments)
+            {
+                j_cell["evaluated_skewness"].push_back(m.skewness());
+                j_cell["evaluated_kurtosis"].push_back(m.kurtosis());
+            }
+        }
+        return j_cell;
+    }
+
+    json evaluateCellStatistics(const cv::Mat &collage, const CellRoi &cell, unsigned statistics, bool with_sketch)
+    {
+        // Для сводки гистограмма нужна всегда, даже если выводятся только моменты
+        std::vector<CellStatistics> channels = getChannelStatistics(collage, cell.spans, with_sketch ? STAT_ALL : statistics);
+
+        json j_cell;
+        j_cell["row"] = cell.row;
+        j_cell["column"] = cell.col;
+        for (unsigned bit = 1; bit <= STAT_ALL; bit <<= 1)
+        {
+            if (!(statistics & bit))
+                continue;
+            const StatisticFlags statistic = static_cast<StatisticFlags>(bit);
+            const std::string key = "evaluated_" + statisticName(statistic);
+            if (channels.size() == 1)
+                j_cell[key] = channels[0].value(statistic);
+            else
+                for (const CellStatistics &c : channels)
+                    j_cell[key].push_back(c.value(statistic));
+        }
+        if (with_sketch)
+            for (const CellStatistics &c : channels)
+                j_cell["sketch"].push_back(sketchToJson(c));
+        return j_cell;
+    }
+
+    void evaluateBlocks(const CollageLayout &layout, const std::function<json(const CellRoi &)> &evaluate,
+                        const CellSink &sink)
+    {
+        const size_t n_cells = layout.cells.size();
+        std::vector<json> block;
+        for (size_t first = 0; first < n_cells; first += CELL_BLOCK)
+        {
+            const size_t count = std::min<size_t>(CELL_BLOCK, n_cells - first);
+            block.assign(count, json());
+            cv::parallel_for_(cv::Range(0, static_cast<int>(count)), [&](const cv::Range &range)
+                              {
+                for (int i = range.start; i < range.end; i++)
+                    block[i] = evaluate(layout.cells[first + i]); });
+            for (size_t i = 0; i < count; i++)
+                sink(first + i, block[i]);
+        }
+        TRACE_COUNTER("eval.cells", static_cast<double>(n_cells));
+    }
+
+    json collectCells(const std::function<void(const CellSink &)> &evaluate)
+    {
+        std::vector<json> cells_array;
+        evaluate([&](size_t, json &cell)
+                 { cells_array.push_back(std::move(cell)); });
+        json j_result;
+        j_result["cells"] = cells_array;
+        return j_result;
+    }
+}
+
+void evaluateCollage(const cv::Mat &collage, const CollageLayout &layout, const ApproxOptions *approx,
+                     const CellSink &sink)
+{
+    CV_Assert(collage.size() == layout.size);
+    evaluateBlocks(layout, [&](const CellRoi &cell)
+                   { return evaluateCell(collage, cell, approx); }, sink);
+}
+
+json evaluateCollage(const cv::Mat &collage, const CollageLayout &layout, const ApproxOptions *approx)
+{
+    return collectCells([&](const CellSink &sink)
+                        { evaluateCollage(collage, layout, approx, sink); });
+}
+
+void evaluateCollageStatistics(const cv::Mat &collage, const CollageLayout &layout, unsigned statistics,
+                               bool with_sketch, const CellSink &sink)
+{
+    CV_Assert(collage.size() == layout.size);
+    statistics |= STAT_MOMENTS;
+    evaluateBlocks(layout, [&](const CellRoi &cell)
+                   { return evaluateCellStatistics(collage, cell, statistics, with_sketch); }, sink);
+}
+
+json evaluateCollageStatistics(const cv::Mat &collage, const CollageLayout &layout, unsigned statistics,
+                               bool with_sketch)
+{
+    return collectCells([&](const CellSink &sink)
+                        { evaluateCollageStatistics(collage, layout, statistics, with_sketch, sink); });
+}
+
+bool parseEvaluationOptions(const std::vector<std::string> &args, EvaluationOptions &options, std::string &error)
+{
+    try
+    {
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            const std::string &arg = args[i];
+            const bool has_value = i + 1 < args.size();
+            if (arg == "--auto-layout")
+                options.auto_layout = true;
+            else if (arg == "--layout-key" && has_value)
+                options.layout_key = args[++i];
+            else if (arg == "--bootstrap" && has_value)
+            {
+                options.with_intervals = true;
+                options.bootstrap.method = ResampleMethod::Bootstrap;
+                options.bootstrap.resamples = std::stoi(args[++i]);
+            }
+            else if (arg == "--jackknife")
+            {
+                options.with_intervals = true;
+                options.bootstrap.method = ResampleMethod::Jackknife;
+            }
+            else if (arg == "--block-size" && has_value)
+                options.bootstrap.block_size = std::stoi(args[++i]);
+            else if (arg == "--confidence" && has_value)
+                options.bootstrap.confidence = std::stod(args[++i]);
+            else if (arg == "--ci-seed" && has_value)
+                options.bootstrap.seed = std::stoull(args[++i]);
+            else if (arg == "--approx" && has_value)
+            {
+                options.with_approx = true;
+                options.approx.tolerance = std::stod(args[++i]);
+            }
+            else if (arg == "--approx-max-fraction" && has_value)
+                options.approx.max_fraction = std::stod(args[++i]);
+            else if (arg == "--approx-seed" && has_value)
+                options.approx.seed = std::stoull(args[++i]);
+            else if (arg == "--sketch")
+                options.with_sketch = true;
+            else if (arg == "--ndjson")
+                options.ndjson = true;
+            else if (arg == "--stats" && has_value)
+            {
+                if (!parseStatistics(args[++i], options.statistics))
+                {
+                    error = "Unknown statistic in: " + args[i] +
+                            " (skewness, kurtosis, bowley, medcouple, l_skewness, l_kurtosis, all)";
+                    return false;
+                }
+            }
+            else
+            {
+                error = "Unknown or incomplete option: " + arg;
+                return false;
+            }
+        }
+    }
+    catch (const std::exception &)
+    {
+        error = "Invalid numeric value in options";
+        return false;
+    }
+
+    const BootstrapOptions &bootstrap = options.bootstrap;
+    if (bootstrap.resamples < 2)
+        error = "--bootstrap needs at least 2 resamples";
+    else if (bootstrap.block_size <= 0)
+        error = "--block-size must be positive";
+    else if (!(bootstrap.confidence > 0.0 && bootstrap.confidence < 1.0))
+        error = "--confidence must be in (0, 1)";
+    else if (!(options.approx.tolerance > 0.0 && std::isfinite(options.approx.tolerance)))
+        error = "--approx tolerance must be a positive number";
+    else if (!(options.approx.max_fraction > 0.0 && options.approx.max_fraction <= 1.0))
+        error = "--approx-max-fraction must be in (0, 1]";
+    else if (options.with_approx && ((options.statistics & ~STAT_MOMENTS) || options.with_sketch))
+        error = "--approx cannot be combined with --stats beyond moments or --sketch (they need all pixels)";
+    return error.empty();
+}
+
+json evaluationHeader(const StorageInfo &storage, const EvaluationOptions &options)
+{
+    json header = json::object();
+    if (storage.format != StorageFormat::Float32)
+        header["storage"] = storageFormatName(storage.format);
+    if (options.with_intervals)
+    {
+        header["confidence"] = options.bootstrap.confidence;
+        header["resampling"] = options.bootstrap.method == ResampleMethod::Jackknife ? "jackknife" : "bootstrap";
+    }
+    return header;
+}
+
+// Интервалы строятся по одному каналу (blockSummaries); проверка до записи
+// чего-либо в файл, чтобы не оставлять NDJSON с одним заголовком
+static void checkEvaluationInput(const cv::Mat &image, const EvaluationOptions &options)
+{
+    if (options.with_intervals && image.channels() != 1)
+        throw std::runtime_error("--bootstrap/--jackknife need a single-channel image, got " +
+                                 std::to_string(image.channels()) + " channels");
+}
+
+void evaluateImage(const cv::Mat &image, const CollageLayout &layout, const EvaluationOptions &options,
+                   const CellSink &sink)
+{
+    checkEvaluationInput(image, options);
+    std::vector<CellConfidence> intervals;
+    if (options.with_intervals)
+        intervals = bootstrapCollage(image, layout, options.bootstrap);
+
+    CellSink with_intervals = [&](size_t i, json &cell)
+    {
+        if (i < intervals.size())
+        {
+            cell["skewness_ci"] = {intervals[i].skewness.lower, intervals[i].skewness.upper};
+            cell["kurtosis_ci"] = {intervals[i].kurtosis.lower, intervals[i].kurtosis.upper};
+            cell["skewness_se"] = intervals[i].skewness.std_error;
+            cell["kurtosis_se"] = intervals[i].kurtosis.std_error;
+        }
+        sink(i, cell);
+    };
+
+    // Дополнительные статистики и сводки требуют гистограмму и считаются точно;
+    // вместе с with_approx их не пропускает parseEvaluationOptions
+    if ((options.statistics & ~STAT_MOMENTS) || options.with_sketch)
+        evaluateCollageStatistics(image, layout, options.statistics, options.with_sketch, with_intervals);
+    else
+        evaluateCollage(image, layout, options.with_approx ? &options.approx : nullptr, with_intervals);
+}
+
+json evaluateDocument(const cv::Mat &image, const StorageInfo &storage, const CollageLayout &layout,
+                      const EvaluationOptions &options)
+{
+    std::vector<json> cells_array;
+    evaluateImage(image, layout, options, [&](size_t, json &cell)
+                  { cells_array.push_back(std::move(cell)); });
+    json document = evaluationHeader(storage, options);
+    document["cells"] = std::move(cells_array);
+    return document;
+}
+
+bool writeEvaluation(const std::string &path, const cv::Mat &image, const StorageInfo &storage,
+                     const CollageLayout &layout, const EvaluationOptions &options)
+{
+    checkEvaluationInput(image, options);
+    if (options.ndjson)
+    {
+        NdjsonWriter writer(path);
+        if (!writer.isOpen())
+            return false;
+        json header = evaluationHeader(storage, options);
+        header["cells"] = layout.cells.size();
+        writer.write(header);
+        evaluateImage(image, layout, options, [&](size_t, json &cell)
+                      { writer.write(cell); });
+        return true;
+    }
+
+    const json evaluation = evaluateDocument(image, storage, layout, options);
+    std::string evaluation_text;
+    {
+        TRACE_SCOPE("json.serialize");
+        evaluation_text = evaluation.dump(4);
+    }
+    TRACE_SCOPE("file.write");
+    std::ofstream out_file(path);
+    if (!out_file.is_open())
+        return false;
+    out_file << evaluation_text << std::endl;
+    return true;
+}
@@ -1,6 +1,11 @@
 #include "generator.h"
+#include "trace.h"
+#include "prediction.h"
+#include "evaluator.h"
+#include "results.h"
 #include <cmath>
 #include <fstream>
+#include <memory>
 
 ImageGenerator::ImageGenerator(const std::string &config_path, int seed)
 {
@@ -32,7 +37,13 @@ ImageGenerator::ImageGenerator(int seed)
     }
 }
 
-cv::Mat ImageGenerator::generate_collage(const std::string &gt_path)
+ImageGenerator::ImageGenerator(int distribution, double snr_db, int seed)
+    : distribution(distribution), snr_db(snr_db), seed(static_cast<unsigned>(seed))
+{
+    rng.seed(this->seed);
+}
+
+cv::Mat ImageGenerator::generate_collage(const std::string &gt_path, bool ndjson)
 {
     json gt_json;
     gt_json["distribution"] = distribution;
@@ -46,6 +57,16 @@ cv::Mat ImageGenerator::generate_collage(const std::string &gt_path)
 
     json objects = json::array();
 
+    // В NDJSON заголовок пишется сразу, а ячейки — по мере генерации
+    std::unique_ptr<NdjsonWriter> writer;
+    if (ndjson)
+    {
+        writer = std::make_unique<NdjsonWriter>(gt_path);
+        json header = gt_json;
+        header["cells"] = means.size() * stddevs.size();
+        writer->write(header);
+    }
+
     for (int row = 0; row < stddevs.size(); ++row)
     {
         for (int col = 0; col < means.size(); ++col)
@@ -70,39 +91,66 @@ cv::Mat ImageGenerator::generate_collage(const std::string &gt_path)
 
             auto [theor_skew, theor_kurt] = getTheoretical(distribution);
 
+            // Ожидаемые значения с учётом шума; аргументы те же, что у generate_cell
+            PredictedMoments predicted = predictCellMoments(distribution, stddevs[row], means[col], snr_db);
+
             json obj;
-            obj["pic_coordinates"]["row"] = row;
-            obj["pic_coordinates"]["col"] = col;
             obj["theoretical_skewness"] = theor_skew;
             obj["theoretical_kurtosis"] = theor_kurt;
+            obj["predicted_skewness"] = predicted.skewness;
+            obj["predicted_kurtosis"] = predicted.kurtosis;
             obj["mean"] = means[col];
             obj["std"] = stddevs[row];
 
+            if (writer)
+            {
+                obj["row"] = row;
+                obj["column"] = col;
+                writer->write(obj);
+                continue;
+            }
+            obj["pic_coordinates"]["row"] = row;
+            obj["pic_coordinates"]["col"] = col;
             objects.push_back(obj);
         }
     }
 
     // cv::Mat noisy_collage = applyGaussianNoise(collage, snr_db);
 
+    if (writer)
+        return collage;
+
     gt_json["cells"] = objects;
 
-    std::ofstream gt_file(gt_path);
-    gt_file << std::setw(4) << gt_json << std::endl;
+    std::string gt_text;
+    {
+        TRACE_SCOPE("json.serialize");
+        gt_text = gt_json.dump(4);
+    }
+    {
+        TRACE_SCOPE("file.write");
+        std::ofstream gt_file(gt_path);
+        gt_file << gt_text << std::endl;
+    }
     return collage;
 }
 
 cv::Mat ImageGenerator::generateCollage1(int distribution)
 {
-    cv::Mat collage(1280, 1280, CV_32FC1); // 5*256 = 1280
+    return generateGrid(distribution, GridSpec());
+}
 
-    std::vector<double> means = {44.0, 88.0, 132.0, 176.0, 220.0};
-    std::vector<double> stddevs = {0.5, 1.0, 1.5, 2.0, 2.5};
+cv::Mat ImageGenerator::generateGrid(int distribution, const GridSpec &grid)
+{
+    const int rows = static_cast<int>(grid.means.size());
+    const int cols = static_cast<int>(grid.stddevs.size());
+    cv::Mat collage(rows * 256, cols * 256, CV_32FC1); // 5*256 = 1280 для сетки по умолчанию
 
-    for (int row = 0; row < 5; row++)
+    for (int row = 0; row < rows; row++)
     {
-        for (int col = 0; col < 5; col++)
+        for (int col = 0; col < cols; col++)
         {
-            cv::Mat cell = generate_cell1(distribution, means[row], stddevs[col]);
+            cv::Mat cell = generate_cell1(distribution, grid.means[row], grid.stddevs[col]);
             cell.copyTo(collage(cv::Rect(col * 256, row * 256, 256, 256)));
         }
     }
@@ -112,33 +160,38 @@ cv::Mat ImageGenerator::generateCollage1(int distribution)
 
 cv::Mat ImageGenerator::generate_cell(double mean, double stddev)
 {
+    TRACE_SCOPE("gen.cell");
     cv::Mat cell(256, 256, CV_32FC1, cv::Scalar(0.0f)); // Черный фон
 
     cv::Mat roi = cell(cv::Rect(14, 14, 228, 228));
 
-    if (distribution == 0)
     {
-        cv::randn(roi, mean, stddev);
-    }
-    else if (distribution == 1)
-    {
-        double a = mean - std::sqrt(3.0) * stddev;
-        double b = mean + std::sqrt(3.0) * stddev;
-        cv::randu(roi, cv::Scalar(a), cv::Scalar(b));
-    }
-    else if (distribution == 2)
-    {
-        std::exponential_distribution<double> exp_dist(1.0 / mean);
-        for (int y = 0; y < roi.rows; y++)
+        TRACE_SCOPE("gen.rng_sample");
+        if (distribution == 0)
         {
-            float *ptr = roi.ptr<float>(y);
-            for (int x = 0; x < roi.cols; x++)
+            cv::randn(roi, mean, stddev);
+        }
+        else if (distribution == 1)
+        {
+            double a = mean - std::sqrt(3.0) * stddev;
+            double b = mean + std::sqrt(3.0) * stddev;
+            cv::randu(roi, cv::Scalar(a), cv::Scalar(b));
+        }
+        else if (distribution == 2)
+        {
+            std::exponential_distribution<double> exp_dist(1.0 / mean);
+            for (int y = 0; y < roi.rows; y++)
             {
-                ptr[x] = exp_dist(rng);
+                float *ptr = roi.ptr<float>(y);
+                for (int x = 0; x < roi.cols; x++)
+                {
+                    ptr[x] = exp_dist(rng);
+                }
             }
         }
     }
 
+    TRACE_SCOPE("gen.noise");
     double signal_power = stddev * stddev;
     double snr_linear = std::pow(10.0, snr_db / 10.0);
     double noise_power = signal_power / snr_linear;
@@ -152,6 +205,7 @@ cv::Mat ImageGenerator::generate_cell(double mean, double stddev)
 
 cv::Mat ImageGenerator::generate_cell1(int distribution, double mean, double stddev)
 {
+    TRACE_SCOPE("gen.rng_sample");
     cv::Mat cell(256, 256, CV_32FC1, cv::Scalar(0.0f)); // Черный фон
 
     // Внутренний квадрат (228x228)
@@ -185,6 +239,7 @@ cv::Mat ImageGenerator::generate_cell1(int distribution, double mean, double std
 
 cv::Mat ImageGenerator::applyGaussianNoise(const cv::Mat &image, double snr_db)
 {
+    TRACE_SCOPE("gen.noise");
     CV_Assert(image.type() == CV_32FC1);
 
     cv::Scalar mean, stddev;
@@ -201,14 +256,16 @@ cv::Mat ImageGenerator::applyGaussianNoise(const cv::Mat &image, double snr_db)
     return image + noise;
 }
 
-json ImageGenerator::createMetadata(int distribution, double snr_db)
+json ImageGenerator::createMetadata(int distribution, double snr_db, const GridSpec &grid)
 {
     json j;
     j["distribution"] = distribution;
     j["snr_db"] = snr_db;
 
-    std::vector<double> means = {44.0, 88.0, 132.0, 176.0, 220.0};
-    std::vector<double> stddevs = {0.5, 1.0, 1.5, 2.0, 2.5};
+    const std::vector<double> &means = grid.means;
+    const std::vector<double> &stddevs = grid.stddevs;
+    const int rows = static_cast<int>(means.size());
+    const int cols = static_cast<int>(stddevs.size());
 
     // Теоретические значения для распределений
     auto getTheoretical = [](const int dist) -> std::pair<double, double>
@@ -224,16 +281,26 @@ json ImageGenerator::createMetadata(int distribution, double snr_db)
 
     auto [theor_skew, theor_kurt] = getTheoretical(distribution);
 
-    for (int row = 0; row < 5; row++)
+    // Ожидаемые значения с учётом шума applyGaussianNoise (ROI 228x228 в ячейке 256x256)
+    std::vector<CellSpec> specs;
+    for (int row = 0; row < rows; row++)
+        for (int col = 0; col < cols; col++)
+            specs.push_back({means[row], stddevs[col]});
+    std::vector<PredictedMoments> predicted = predictCollageMoments(distribution, snr_db, specs,
+                                                                    228.0 * 228.0 / (rows * 256.0 * cols * 256.0));
+
+    for (int row = 0; row < rows; row++)
     {
         json j_row;
-        for (int col = 0; col < 5; col++)
+        for (int col = 0; col < cols; col++)
         {
             json j_cell;
             j_cell["mean"] = means[row];
             j_cell["stddev"] = stddevs[col];
             j_cell["theoretical_skewness"] = theor_skew;
             j_cell["theoretical_kurtosis"] = theor_kurt;
+            j_cell["predicted_skewness"] = predicted[row * cols + col].skewness;
+            j_cell["predicted_kurtosis"] = predicted[row * cols + col].kurtosis;
             j_row.push_back(j_cell);
         }
         j["cells"].push_back(j_row);
@@ -247,6 +314,9 @@ void ImageGenerator::generateAll()
     std::vector<int> distributions = {0, 1, 2};
     std::vector<double> snr_levels = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
 
+    // Раскладка для оценки ошибки хранения в компактных форматах
+    const CollageLayout layout = layoutFromMask(createCollageMask());
+
     for (const auto &dist : distributions)
     {
         cv::Mat clean_collage = generateCollage1(dist);
@@ -259,16 +329,63 @@ void ImageGenerator::generateAll()
             // Сохранение изображения
             std::string filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB.tiff";
             std::string image_path = "../src/test_images/" + filename;
-            cv::imwrite(image_path, noisy_collage);
+            writeCollage(image_path, noisy_collage, storage, &layout);
 
             // Создание и сохранение метаданных
             json metadata = createMetadata(dist, snr_db);
             std::string json_file_name = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB.json";
             std::string json_path = "../src/gt/" + json_file_name;
+            std::string metadata_text;
+            {
+                TRACE_SCOPE("json.serialize");
+                metadata_text = metadata.dump(4);
+            }
+            TRACE_SCOPE("file.write");
             std::ofstream json_file(json_path);
-            json_file << metadata.dump(4);
+            json_file << metadata_text;
+        }
+    }
+}
+
+json ImageGenerator::predictAll(const std::vector<int> &distributions, const std::vector<double> &snr_levels,
+                               const GridSpec &grid)
+{
+    json result = json::array();
+    for (const auto &dist : distributions)
+    {
+        for (double snr_db : snr_levels)
+        {
+            // Та же разметка, что пишет generateAll, но без рендеринга
+            json metadata = createMetadata(dist, snr_db, grid);
+
+            double total_skew_error = 0.0;
+            double total_kurt_error = 0.0;
+            int cell_count = 0;
+            for (const auto &j_row : metadata["cells"])
+            {
+                for (const auto &j_cell : j_row)
+                {
+                    double theor_skew = j_cell["theoretical_skewness"];
+                    double theor_kurt = j_cell["theoretical_kurtosis"];
+                    double pred_skew = j_cell["predicted_skewness"];
+                    double pred_kurt = j_cell["predicted_kurtosis"];
+                    // Относительная ошибка, для нулевой теории — абсолютная (как в ass)
+                    total_skew_error += std::fabs(theor_skew) < 1e-6 ? std::fabs(pred_skew)
+                                                                     : std::fabs((pred_skew - theor_skew) / theor_skew);
+                    total_kurt_error += std::fabs(theor_kurt) < 1e-6 ? std::fabs(pred_kurt)
+                                                                     : std::fabs((pred_kurt - theor_kurt) / theor_kurt);
+                    cell_count++;
+                }
+            }
+
+            if (cell_count == 0)
+                continue;
+            metadata["predicted_mean_skewness_error"] = total_skew_error / cell_count;
+            metadata["predicted_mean_kurtosis_error"] = total_kurt_error / cell_count;
+            result.push_back(std::move(metadata));
         }
     }
+    return result;
 }
 
 void ImageGenerator::parseConfig(const json &config)
@@ -276,6 +393,8 @@ void ImageGenerator::parseConfig(const json &config)
     distribution = config.value("distribution", 0);
     snr_db = config.value("snr_db", 50.0);
     seed = config.value("seed", 0);
+    if (!parseStorageFormat(config.value("storage", "float32"), storage))
+        throw std::runtime_error("Unknown storage format in config");
 }
 
 void ImageGenerator::generate_default_config(const std::string &path)
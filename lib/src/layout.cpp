@@ -0,0 +1,335 @@
+#include "layout.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+
+// Медиана по копии значений
+static double median(std::vector<float> values)
+{
+    CV_Assert(!values.empty());
+    auto mid = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), mid, values.end());
+    return *mid;
+}
+
+// Номера строк/столбцов сетки: центры ближе половины типичного размера
+// ячейки относятся к одной строке (столбцу)
+static std::vector<int> gridIndices(const std::vector<double> &centers, double typical_size)
+{
+    std::vector<int> order(centers.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = static_cast<int>(i);
+    std::sort(order.begin(), order.end(), [&](int a, int b)
+              { return centers[a] < centers[b]; });
+
+    std::vector<int> indices(centers.size(), 0);
+    int current = 0;
+    for (size_t i = 1; i < order.size(); i++)
+    {
+        if (centers[order[i]] - centers[order[i - 1]] > typical_size / 2)
+            current++;
+        indices[order[i]] = current;
+    }
+    return indices;
+}
+
+CollageLayout layoutFromMask(const cv::Mat &mask, int min_area)
+{
+    CV_Assert(mask.type() == CV_8UC1);
+
+    cv::Mat labels, stats, centroids;
+    int n_labels = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+
+    // Метка компоненты -> индекс ячейки (-1 для фона и мелких компонент)
+    std::vector<int> cell_of_label(n_labels, -1);
+    std::vector<CellRoi> cells;
+    for (int label = 1; label < n_labels; label++)
+    {
+        if (stats.at<int>(label, cv::CC_STAT_AREA) < min_area)
+            continue;
+        CellRoi cell;
+        cell.bbox = cv::Rect(stats.at<int>(label, cv::CC_STAT_LEFT),
+                             stats.at<int>(label, cv::CC_STAT_TOP),
+                             stats.at<int>(label, cv::CC_STAT_WIDTH),
+                             stats.at<int>(label, cv::CC_STAT_HEIGHT));
+        cell_of_label[label] = static_cast<int>(cells.size());
+        cells.push_back(std::move(cell));
+    }
+
+    // Разбиение строк меток на отрезки
+    for (int y = 0; y < labels.rows; y++)
+    {
+        const int *row = labels.ptr<int>(y);
+        int x = 0;
+        while (x < labels.cols)
+        {
+            int label = row[x];
+            int x0 = x;
+            while (x < labels.cols && row[x] == label)
+                x++;
+            if (label > 0 && cell_of_label[label] >= 0)
+                cells[cell_of_label[label]].spans.push_back({y, x0, x});
+        }
+    }
+
+    CollageLayout layout;
+    layout.size = mask.size();
+    if (cells.empty())
+        return layout;
+
+    std::vector<double> cy, cx, heights, widths;
+    for (const CellRoi &cell : cells)
+    {
+        cy.push_back(cell.bbox.y + cell.bbox.height / 2.0);
+        cx.push_back(cell.bbox.x + cell.bbox.width / 2.0);
+        heights.push_back(cell.bbox.height);
+        widths.push_back(cell.bbox.width);
+    }
+    std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+    std::nth_element(widths.begin(), widths.begin() + widths.size() / 2, widths.end());
+    std::vector<int> rows = gridIndices(cy, heights[heights.size() / 2]);
+    std::vector<int> cols = gridIndices(cx, widths[widths.size() / 2]);
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        cells[i].row = rows[i];
+        cells[i].col = cols[i];
+    }
+    std::sort(cells.begin(), cells.end(), [](const CellRoi &a, const CellRoi &b)
+              { return a.row != b.row ? a.row < b.row : a.col < b.col; });
+
+    layout.cells = std::move(cells);
+    return layout;
+}
+
+CollageLayout detectCollageLayout(const cv::Mat &image, const DetectionParams &params)
+{
+    TRACE_SCOPE("layout.detect");
+    CV_Assert(image.channels() == 1);
+
+    cv::Mat image_float;
+    image.convertTo(image_float, CV_32F);
+
+    // Сглаживание подавляет шум, граница ступеньки на уровне 50% при этом не смещается
+    cv::Mat blurred;
+    cv::blur(image_float, blurred, cv::Size(params.blur_size, params.blur_size));
+
+    // Фон и его разброс по внешней рамке изображения (медиана и MAD)
+    std::vector<float> ring;
+    for (int x = 0; x < blurred.cols; x++)
+    {
+        ring.push_back(blurred.at<float>(0, x));
+        ring.push_back(blurred.at<float>(blurred.rows - 1, x));
+    }
+    for (int y = 1; y < blurred.rows - 1; y++)
+    {
+        ring.push_back(blurred.at<float>(y, 0));
+        ring.push_back(blurred.at<float>(y, blurred.cols - 1));
+    }
+    const double background = median(ring);
+    for (float &v : ring)
+        v = std::abs(v - static_cast<float>(background));
+    const double sigma = std::max(1.4826 * median(ring), 1e-6);
+
+    cv::Mat deviation;
+    cv::absdiff(blurred, cv::Scalar(background), deviation);
+
+    // Грубый проход: всё, что заметно отличается от фона
+    cv::Mat coarse;
+    cv::threshold(deviation, coarse, params.threshold_sigma * sigma, 255.0, cv::THRESH_BINARY);
+    coarse.convertTo(coarse, CV_8U);
+    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+    cv::morphologyEx(coarse, coarse, cv::MORPH_OPEN, kernel);
+
+    cv::Mat labels, stats, centroids;
+    int n_labels = cv::connectedComponentsWithStats(coarse, labels, stats, centroids, 8, CV_32S);
+
+    // Точный проход: порог на середине между фоном и уровнем ячейки
+    cv::Mat fine(image.size(), CV_8UC1, cv::Scalar(0));
+    const int margin = params.blur_size;
+    const cv::Rect image_rect(0, 0, image.cols, image.rows);
+    for (int label = 1; label < n_labels; label++)
+    {
+        if (stats.at<int>(label, cv::CC_STAT_AREA) < params.min_area)
+            continue;
+        cv::Rect bbox(stats.at<int>(label, cv::CC_STAT_LEFT),
+                      stats.at<int>(label, cv::CC_STAT_TOP),
+                      stats.at<int>(label, cv::CC_STAT_WIDTH),
+                      stats.at<int>(label, cv::CC_STAT_HEIGHT));
+
+        cv::Rect core(bbox.x + margin, bbox.y + margin, bbox.width - 2 * margin, bbox.height - 2 * margin);
+        if (core.width <= 0 || core.height <= 0)
+            core = bbox;
+        const double level = cv::mean(deviation(core))[0];
+
+        cv::Rect search(bbox.x - margin, bbox.y - margin, bbox.width + 2 * margin, bbox.height + 2 * margin);
+        search = search & image_rect;
+        cv::Mat cell_mask;
+        cv::threshold(deviation(search), cell_mask, level / 2.0, 255.0, cv::THRESH_BINARY);
+        cell_mask.convertTo(cell_mask, CV_8U);
+
+        cv::Mat target = fine(search);
+        cv::bitwise_or(target, cell_mask, target);
+    }
+
+    // Закрытие склеивает ячейку, разорванную сильным шумом; промежутки между
+    // ячейками шире окна сглаживания и не закрываются
+    cv::Mat close_kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(params.blur_size, params.blur_size));
+    cv::morphologyEx(fine, fine, cv::MORPH_CLOSE, close_kernel);
+    cv::morphologyEx(fine, fine, cv::MORPH_OPEN, kernel);
+    if (params.inset > 0)
+    {
+        cv::Mat inset_kernel = cv::getStructuringElement(
+            cv::MORPH_RECT, cv::Size(2 * params.inset + 1, 2 * params.inset + 1));
+        cv::erode(fine, fine, inset_kernel);
+    }
+
+    // Обрывки много меньше типичной ячейки отбрасываются
+    n_labels = cv::connectedComponentsWithStats(fine, labels, stats, centroids, 8, CV_32S);
+    std::vector<float> areas;
+    for (int label = 1; label < n_labels; label++)
+    {
+        if (stats.at<int>(label, cv::CC_STAT_AREA) >= params.min_area)
+            areas.push_back(static_cast<float>(stats.at<int>(label, cv::CC_STAT_AREA)));
+    }
+    int min_area = params.min_area;
+    if (!areas.empty())
+        min_area = std::max(min_area, static_cast<int>(median(areas) / 4));
+
+    return layoutFromMask(fine, min_area);
+}
+
+bool layoutMatchesImage(const cv::Mat &image, const CollageLayout &layout, const DetectionParams &params)
+{
+    if (image.size() != layout.size || image.channels() != 1)
+        return false;
+    TRACE_SCOPE("layout.verify");
+
+    // Уменьшение усреднением: шум падает в factor раз, проверка стоит
+    // одного прохода по изображению
+    const int factor = std::max(1, params.blur_size / 2);
+    const cv::Size small_size(std::max(1, image.cols / factor), std::max(1, image.rows / factor));
+    cv::Mat image_float, small;
+    image.convertTo(image_float, CV_32F);
+    cv::resize(image_float, small, small_size, 0, 0, cv::INTER_AREA);
+    const double sx = static_cast<double>(small.cols) / image.cols;
+    const double sy = static_cast<double>(small.rows) / image.rows;
+
+    // Ожидание по раскладке: 0 — фон, 1 — внутренность ячейки, 2 — полоса у границы
+    cv::Mat expected(small.size(), CV_8UC1, cv::Scalar(0));
+    const cv::Rect small_rect(0, 0, small.cols, small.rows);
+    for (const CellRoi &cell : layout.cells)
+    {
+        cv::Rect r(static_cast<int>(std::floor(cell.bbox.x * sx)), static_cast<int>(std::floor(cell.bbox.y * sy)),
+                   static_cast<int>(std::ceil(cell.bbox.width * sx)), static_cast<int>(std::ceil(cell.bbox.height * sy)));
+        expected(cv::Rect(r.x - 2, r.y - 2, r.width + 4, r.height + 4) & small_rect).setTo(2);
+    }
+    for (const CellRoi &cell : layout.cells)
+    {
+        cv::Rect r(static_cast<int>(std::ceil(cell.bbox.x * sx)) + 1, static_cast<int>(std::ceil(cell.bbox.y * sy)) + 1,
+                   static_cast<int>(std::floor(cell.bbox.width * sx)) - 2, static_cast<int>(std::floor(cell.bbox.height * sy)) - 2);
+        r = r & small_rect;
+        if (r.width > 0 && r.height > 0)
+            expected(r).setTo(1);
+    }
+
+    // Фон по рамке, как в detectCollageLayout
+    std::vector<float> ring;
+    for (int x = 0; x < small.cols; x++)
+    {
+        ring.push_back(small.at<float>(0, x));
+        ring.push_back(small.at<float>(small.rows - 1, x));
+    }
+    for (int y = 1; y < small.rows - 1; y++)
+    {
+        ring.push_back(small.at<float>(y, 0));
+        ring.push_back(small.at<float>(y, small.cols - 1));
+    }
+    const double background = median(ring);
+    for (float &v : ring)
+        v = std::abs(v - static_cast<float>(background));
+    const double sigma = std::max(1.4826 * median(ring), 1e-6);
+
+    cv::Mat deviation;
+    cv::absdiff(small, cv::Scalar(background), deviation);
+
+    // Порог — половина типичного уровня ячеек, но не ниже шума фона
+    std::vector<float> inside;
+    for (int y = 0; y < small.rows; y++)
+        for (int x = 0; x < small.cols; x++)
+            if (expected.at<uchar>(y, x) == 1)
+                inside.push_back(deviation.at<float>(y, x));
+    const double threshold = std::max(params.threshold_sigma * sigma, inside.empty() ? 0.0 : median(inside) / 2.0);
+
+    int checked = 0, mismatched = 0;
+    for (int y = 0; y < small.rows; y++)
+    {
+        for (int x = 0; x < small.cols; x++)
+        {
+            const uchar e = expected.at<uchar>(y, x);
+            if (e == 2)
+                continue;
+            const bool foreground = deviation.at<float>(y, x) > threshold;
+            checked++;
+            if (foreground != (e == 1))
+                mismatched++;
+        }
+    }
+    return checked > 0 && mismatched <= checked / 50;
+}
+
+std::string layoutSignature(const cv::Mat &image, const std::string &key)
+{
+    return std::to_string(image.cols) + "x" + std::to_string(image.rows) + ":" +
+           std::to_string(image.type()) + (key.empty() ? "" : ":" + key);
+}
+
+LayoutCache::LayoutCache(const DetectionParams &params) : params(params) {}
+
+std::vector<std::shared_ptr<const CollageLayout>> LayoutCache::snapshot(Entry &entry, size_t from) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<std::shared_ptr<const CollageLayout>>(entry.layouts.begin() + std::min(from, entry.layouts.size()),
+                                                             entry.layouts.end());
+}
+
+std::shared_ptr<const CollageLayout> LayoutCache::get(const cv::Mat &image, const std::string &key)
+{
+    const std::string signature = layoutSignature(image, key);
+
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<Entry> &slot = entries[signature];
+        if (!slot)
+            slot = std::make_shared<Entry>();
+        entry = slot;
+    }
+
+    // Подпись не различает раскладки одного размера, поэтому кэшированные
+    // раскладки сверяются с изображением — по копии списка, без замка
+    std::vector<std::shared_ptr<const CollageLayout>> candidates = snapshot(*entry, 0);
+    for (const auto &candidate : candidates)
+        if (layoutMatchesImage(image, *candidate, params))
+            return candidate;
+
+    // Детектирование одной подписи идёт по очереди; ожидавший сначала проверяет
+    // раскладки, найденные за это время, чтобы не повторять работу
+    std::lock_guard<std::mutex> detect_lock(entry->detect_mutex);
+    for (const auto &candidate : snapshot(*entry, candidates.size()))
+        if (layoutMatchesImage(image, *candidate, params))
+            return candidate;
+
+    auto layout = std::make_shared<const CollageLayout>(detectCollageLayout(image, params));
+    std::lock_guard<std::mutex> lock(mutex);
+    entry->layouts.push_back(layout);
+    return layout;
+}
+
+size_t LayoutCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t count = 0;
+    for (const auto &[signature, entry] : entries)
+        count += entry->layouts.size();
+    return count;
+}
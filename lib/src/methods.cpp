@@ -1,6 +1,11 @@
 #include "methods.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 double getSkewnessValue(const cv::Mat& image, const cv::Mat& mask) {
+    TRACE_SCOPE("moments.skewness");
     CV_Assert(image.channels() == 1); 
     CV_Assert(mask.type() == CV_8U);
     
@@ -27,6 +32,7 @@ double getSkewnessValue(const cv::Mat& image, const cv::Mat& mask) {
 }
 
 double getKurtosisValue(const cv::Mat& image, const cv::Mat& mask) {
+    TRACE_SCOPE("moments.kurtosis");
     CV_Assert(image.channels() == 1);
     CV_Assert(mask.type() == CV_8U);
     
@@ -50,4 +56,745 @@ double getKurtosisValue(const cv::Mat& image, const cv::Mat& mask) {
     }
     
     return (sum4 / count) / (sd * sd * sd * sd) - 3.0;
-}
\ No newline at end of file
+}
+
+// Центральные суммы 3-й и 4-й степени по отрезкам; среднее и СКО считаются
+// так же, как в cv::meanStdDev (деление на n)
+static void spanCentralSums(const cv::Mat& image, const std::vector<Span>& spans,
+                            double& sd, double& sum3, double& sum4, long long& count) {
+    CV_Assert(image.type() == CV_32FC1);
+
+    double sum = 0.0;
+    count = 0;
+    for (const Span& s : spans) {
+        const float* row = image.ptr<float>(s.y);
+        for (int x = s.x0; x < s.x1; x++) {
+            sum += row[x];
+        }
+        count += s.x1 - s.x0;
+    }
+    CV_Assert(count > 0);
+    const double m = sum / count;
+
+    double sum2 = 0.0;
+    sum3 = 0.0;
+    sum4 = 0.0;
+    for (const Span& s : spans) {
+        const float* row = image.ptr<float>(s.y);
+        for (int x = s.x0; x < s.x1; x++) {
+            double diff = row[x] - m;
+            double diff2 = diff * diff;
+            sum2 += diff2;
+            sum3 += diff2 * diff;
+            sum4 += diff2 * diff2;
+        }
+    }
+    sd = std::max(std::sqrt(sum2 / count), 1e-10);
+}
+
+double getSkewnessValue(const cv::Mat& image, const std::vector<Span>& spans) {
+    TRACE_SCOPE("moments.skewness");
+    double sd, sum3, sum4;
+    long long count;
+    spanCentralSums(image, spans, sd, sum3, sum4, count);
+    return (sum3 / count) / (sd * sd * sd);
+}
+
+double getKurtosisValue(const cv::Mat& image, const std::vector<Span>& spans) {
+    TRACE_SCOPE("moments.kurtosis");
+    double sd, sum3, sum4;
+    long long count;
+    spanCentralSums(image, spans, sd, sum3, sum4, count);
+    return (sum4 / count) / (sd * sd * sd * sd) - 3.0;
+}
+
+std::vector<Span> maskToSpans(const cv::Mat& mask) {
+    CV_Assert(mask.type() == CV_8U);
+
+    std::vector<Span> spans;
+    for (int y = 0; y < mask.rows; y++) {
+        const uchar* row = mask.ptr<uchar>(y);
+        int x = 0;
+        while (x < mask.cols) {
+            while (x < mask.cols && !row[x])
+                x++;
+            int x0 = x;
+            while (x < mask.cols && row[x])
+                x++;
+            if (x > x0)
+                spans.push_back({y, x0, x});
+        }
+    }
+    return spans;
+}
+
+void MomentSummary::merge(const MomentSummary& other) {
+    if (other.n == 0.0)
+        return;
+    if (n == 0.0) {
+        *this = other;
+        return;
+    }
+
+    const double na = n, nb = other.n;
+    const double total = na + nb;
+    const double delta = other.mean - mean;
+    const double delta2 = delta * delta;
+
+    const double m2 = M2 + other.M2 + delta2 * na * nb / total;
+    const double m3 = M3 + other.M3
+        + delta2 * delta * na * nb * (na - nb) / (total * total)
+        + 3.0 * delta * (na * other.M2 - nb * M2) / total;
+    const double m4 = M4 + other.M4
+        + delta2 * delta2 * na * nb * (na * na - na * nb + nb * nb) / (total * total * total)
+        + 6.0 * delta2 * (na * na * other.M2 + nb * nb * M2) / (total * total)
+        + 4.0 * delta * (na * other.M3 - nb * M3) / total;
+
+    mean += delta * nb / total;
+    M2 = m2;
+    M3 = m3;
+    M4 = m4;
+    n = total;
+}
+
+double MomentSummary::skewness() const {
+    const double sd = std::max(std::sqrt(M2 / n), 1e-10);
+    return (M3 / n) / (sd * sd * sd);
+}
+
+double MomentSummary::kurtosis() const {
+    const double sd = std::max(std::sqrt(M2 / n), 1e-10);
+    return (M4 / n) / (sd * sd * sd * sd) - 3.0;
+}
+
+// Центральные моменты из степенных сумм d = x - shift. Сдвиг на значение
+// из той же строки держит d порядка СКО, и вычитание не теряет точность
+static MomentSummary fromShiftedSums(double n, double shift, double s1, double s2, double s3, double s4) {
+    const double md = s1 / n;
+    const double md2 = md * md;
+
+    MomentSummary summary;
+    summary.n = n;
+    summary.mean = shift + md;
+    summary.M2 = s2 - s1 * md;
+    summary.M3 = s3 - 3.0 * md * s2 + 2.0 * n * md2 * md;
+    summary.M4 = s4 - 4.0 * md * s3 + 6.0 * md2 * s2 - 3.0 * n * md2 * md2;
+    return summary;
+}
+
+// Степенные суммы одного отрезка: все каналы пикселя обрабатываются вместе,
+// суммы сворачиваются в MomentSummary и объединяются. С WithHistogram значения
+// в том же цикле раскладываются по корзинам hists
+template <typename T, int CN, bool WithHistogram>
+static void accumulateRow(const T* row, int len, MomentSummary* out, HistogramSketch* hists) {
+    double shift[CN], s1[CN] = {}, s2[CN] = {}, s3[CN] = {}, s4[CN] = {};
+    for (int c = 0; c < CN; c++)
+        shift[c] = row[c];
+
+    double* bins[CN] = {};
+    double inv_width[CN] = {};
+    long long origin[CN] = {};
+    double lo[CN], hi[CN];
+    if (WithHistogram) {
+        // Диапазон конечных значений отрезка заранее: внутренний цикл пишет
+        // в корзины без укрупнения
+        for (int c = 0; c < CN; c++) {
+            lo[c] = std::numeric_limits<double>::infinity();
+            hi[c] = -std::numeric_limits<double>::infinity();
+            for (int x = 0; x < len; x++) {
+                const double v = row[x * CN + c];
+                if (std::isfinite(v)) {
+                    lo[c] = std::min(lo[c], v);
+                    hi[c] = std::max(hi[c], v);
+                }
+            }
+            if (lo[c] > hi[c])
+                continue; // конечных значений нет, корзины не нужны
+            hists[c].ensureRange(lo[c], hi[c]);
+            bins[c] = hists[c].counts.data();
+            inv_width[c] = hists[c].inv_width;
+            origin[c] = hists[c].origin;
+        }
+    }
+
+    for (int x = 0; x < len; x++) {
+        const T* px = row + x * CN;
+        for (int c = 0; c < CN; c++) {
+            double d = px[c] - shift[c];
+            double d2 = d * d;
+            s1[c] += d;
+            s2[c] += d2;
+            s3[c] += d2 * d;
+            s4[c] += d2 * d2;
+            // NaN и бесконечности в корзины не попадают: сравнение с ними ложно
+            if (WithHistogram && bins[c] && px[c] >= lo[c] && px[c] <= hi[c]) {
+                const auto bin = static_cast<unsigned long long>(
+                    static_cast<long long>(std::floor(px[c] * inv_width[c])) - origin[c]);
+                if (bin < HistogramSketch::BINS)
+                    bins[c][bin] += 1.0;
+            }
+        }
+    }
+
+    for (int c = 0; c < CN; c++)
+        out[c].merge(fromShiftedSums(len, shift[c], s1[c], s2[c], s3[c], s4[c]));
+}
+
+template <typename T, int CN>
+static void accumulateRow(const T* row, int len, MomentSummary* out, HistogramSketch* hists) {
+    if (hists)
+        accumulateRow<T, CN, true>(row, len, out, hists);
+    else
+        accumulateRow<T, CN, false>(row, len, out, hists);
+}
+
+template <typename T, int CN>
+static void accumulateChannels(const cv::Mat& image, const std::vector<Span>& spans, MomentSummary* out, HistogramSketch* hists) {
+    for (const Span& s : spans) {
+        const int len = s.x1 - s.x0;
+        if (len > 0)
+            accumulateRow<T, CN>(image.ptr<T>(s.y) + s.x0 * CN, len, out, hists);
+    }
+}
+
+// float16: отрезок распаковывается в float векторизованным convertTo
+// во временный буфер и сразу накапливается
+template <int CN>
+static void accumulateHalf(const cv::Mat& image, const std::vector<Span>& spans, MomentSummary* out, HistogramSketch* hists) {
+    std::vector<float> buffer;
+    for (const Span& s : spans) {
+        const int len = s.x1 - s.x0;
+        if (len <= 0)
+            continue;
+        buffer.resize(static_cast<size_t>(len) * CN);
+        cv::Mat half(1, len * CN, CV_16F, const_cast<uchar*>(image.ptr(s.y)) + s.x0 * CN * 2);
+        cv::Mat decoded(1, len * CN, CV_32F, buffer.data());
+        half.convertTo(decoded, CV_32F);
+        accumulateRow<float, CN>(buffer.data(), len, out, hists);
+    }
+}
+
+template <typename T>
+static void accumulateDepth(const cv::Mat& image, const std::vector<Span>& spans, MomentSummary* out, HistogramSketch* hists) {
+    switch (image.channels()) {
+    case 1: accumulateChannels<T, 1>(image, spans, out, hists); break;
+    case 2: accumulateChannels<T, 2>(image, spans, out, hists); break;
+    case 3: accumulateChannels<T, 3>(image, spans, out, hists); break;
+    case 4: accumulateChannels<T, 4>(image, spans, out, hists); break;
+    default: CV_Error(cv::Error::StsBadArg, "Only 1-4 channels are supported");
+    }
+}
+
+static void accumulateHalfDepth(const cv::Mat& image, const std::vector<Span>& spans, MomentSummary* out, HistogramSketch* hists) {
+    switch (image.channels()) {
+    case 1: accumulateHalf<1>(image, spans, out, hists); break;
+    case 2: accumulateHalf<2>(image, spans, out, hists); break;
+    case 3: accumulateHalf<3>(image, spans, out, hists); break;
+    case 4: accumulateHalf<4>(image, spans, out, hists); break;
+    default: CV_Error(cv::Error::StsBadArg, "Only 1-4 channels are supported");
+    }
+}
+
+// Один проход по отрезкам; hists == nullptr — только степенные суммы
+static void accumulateImage(const cv::Mat& image, const std::vector<Span>& spans, MomentSummary* out, HistogramSketch* hists) {
+    switch (image.depth()) {
+    case CV_8U: accumulateDepth<uchar>(image, spans, out, hists); break;
+    case CV_16U: accumulateDepth<ushort>(image, spans, out, hists); break;
+    case CV_16S: accumulateDepth<short>(image, spans, out, hists); break;
+    case CV_16F: accumulateHalfDepth(image, spans, out, hists); break;
+    case CV_32F: accumulateDepth<float>(image, spans, out, hists); break;
+    case CV_64F: accumulateDepth<double>(image, spans, out, hists); break;
+    default: CV_Error(cv::Error::StsUnsupportedFormat, "Unsupported image depth");
+    }
+}
+
+std::vector<MomentSummary> getChannelMoments(const cv::Mat& image, const std::vector<Span>& spans) {
+    TRACE_SCOPE("moments.channels");
+    std::vector<MomentSummary> moments(image.channels());
+    accumulateImage(image, spans, moments.data(), nullptr);
+    return moments;
+}
+
+std::vector<MomentSummary> getChannelMoments(const cv::Mat& image, const cv::Mat& mask) {
+    CV_Assert(image.size() == mask.size());
+    return getChannelMoments(image, maskToSpans(mask));
+}
+
+// Укрупнение корзин вдвое; границы остаются кратными новой ширине
+static void coarsen(HistogramSketch& h) {
+    std::vector<double> coarse(HistogramSketch::BINS, 0.0);
+    const long long origin = h.origin >> 1; // сдвиг — деление с округлением вниз
+    for (int i = 0; i < HistogramSketch::BINS; i++)
+        coarse[((h.origin + i) >> 1) - origin] += h.counts[i];
+    h.counts.swap(coarse);
+    h.origin = origin;
+    h.exponent++;
+    h.inv_width *= 0.5;
+}
+
+// Первая и последняя непустые корзины (абсолютные номера); false, если пусто
+static bool occupiedRange(const HistogramSketch& h, long long& first, long long& last) {
+    int i = 0, j = HistogramSketch::BINS - 1;
+    while (i < HistogramSketch::BINS && h.counts[i] == 0.0)
+        i++;
+    if (i == HistogramSketch::BINS)
+        return false;
+    while (h.counts[j] == 0.0)
+        j--;
+    first = h.origin + i;
+    last = h.origin + j;
+    return true;
+}
+
+// Окно корзин, содержащее [lo, hi] (номера при текущей ширине) и все
+// непустые корзины: сначала сдвиг окна, и только если не хватает — укрупнение
+static void fitIndexRange(HistogramSketch& h, long long lo, long long hi) {
+    for (;;) {
+        long long first = lo, last = hi;
+        if (occupiedRange(h, first, last)) {
+            first = std::min(first, lo);
+            last = std::max(last, hi);
+        }
+        if (last - first < HistogramSketch::BINS) {
+            const long long origin = first - (HistogramSketch::BINS - (last - first + 1)) / 2;
+            std::vector<double> moved(HistogramSketch::BINS, 0.0);
+            for (int i = 0; i < HistogramSketch::BINS; i++) {
+                if (h.counts[i] != 0.0)
+                    moved[h.origin + i - origin] = h.counts[i];
+            }
+            h.counts.swap(moved);
+            h.origin = origin;
+            return;
+        }
+        coarsen(h);
+        lo >>= 1;
+        hi >>= 1;
+    }
+}
+
+double HistogramSketch::total() const {
+    double sum = 0.0;
+    for (double c : counts)
+        sum += c;
+    return sum;
+}
+
+void HistogramSketch::ensureRange(double lo, double hi) {
+    if (!std::isfinite(lo) || !std::isfinite(hi))
+        return;
+    const double magnitude = std::max(std::fabs(lo), std::fabs(hi));
+    if (empty()) {
+        // Начальная ширина: диапазон первого отрезка занимает около четверти корзин;
+        // постоянный отрезок получает минимальную ширину
+        exponent = hi > lo ? std::ilogb((hi - lo) / (BINS / 4)) + 1 : MIN_EXPONENT;
+        // Корзины не мельче точности double на этих значениях, номера помещаются в long long
+        if (magnitude > 0.0)
+            exponent = std::max(exponent, std::ilogb(magnitude) - 52);
+        exponent = std::clamp(exponent, MIN_EXPONENT, MAX_EXPONENT);
+        inv_width = std::ldexp(1.0, -exponent);
+        origin = static_cast<long long>(std::floor((lo + hi) / 2 * inv_width)) - BINS / 2;
+        counts.assign(BINS, 0.0);
+    }
+    // Значения намного больше прежних: укрупнение до допустимых номеров корзин
+    while (magnitude * inv_width >= 0x1p62)
+        coarsen(*this);
+    const long long lo_bin = static_cast<long long>(std::floor(lo * inv_width));
+    const long long hi_bin = static_cast<long long>(std::floor(hi * inv_width));
+    if (lo_bin >= origin && hi_bin < origin + BINS)
+        return;
+    fitIndexRange(*this, lo_bin, hi_bin);
+}
+
+void HistogramSketch::add(double x, double weight) {
+    if (!std::isfinite(x))
+        return;
+    ensureRange(x, x);
+    const auto bin = static_cast<unsigned long long>(static_cast<long long>(std::floor(x * inv_width)) - origin);
+    if (bin < BINS)
+        counts[bin] += weight;
+}
+
+void HistogramSketch::merge(const HistogramSketch& other) {
+    if (other.empty())
+        return;
+    if (empty()) {
+        *this = other;
+        return;
+    }
+
+    HistogramSketch aligned = other;
+    while (aligned.exponent < exponent)
+        coarsen(aligned);
+    while (exponent < aligned.exponent)
+        coarsen(*this);
+
+    long long first, last;
+    if (!occupiedRange(aligned, first, last))
+        return;
+    fitIndexRange(*this, first, last);
+    // Укрупнение при подгонке окна могло изменить ширину
+    while (aligned.exponent < exponent)
+        coarsen(aligned);
+    for (int i = 0; i < BINS; i++) {
+        if (aligned.counts[i] != 0.0)
+            counts[aligned.origin + i - origin] += aligned.counts[i];
+    }
+}
+
+void HistogramSketch::reduce(int max_bins) {
+    long long first, last;
+    if (empty() || max_bins <= 0)
+        return;
+    while (occupiedRange(*this, first, last) && last - first >= max_bins)
+        coarsen(*this);
+}
+
+double HistogramSketch::quantile(double p) const {
+    const double n = total();
+    if (n <= 0.0)
+        return 0.0;
+    const double target = std::clamp(p, 0.0, 1.0) * n;
+    double cumulative = 0.0;
+    int last = 0;
+    for (int i = 0; i < BINS; i++) {
+        if (counts[i] == 0.0)
+            continue;
+        last = i;
+        if (cumulative + counts[i] >= target)
+            return (origin + i + (target - cumulative) / counts[i]) * binWidth();
+        cumulative += counts[i];
+    }
+    return (origin + last + 1) * binWidth();
+}
+
+// L-моменты через взвешенные вероятностью моменты b_r = ∫ x F^r dF.
+// Внутри корзины функция квантилей линейна, интеграл берётся точно
+static void lMomentRatios(const HistogramSketch& h, double& tau3, double& tau4) {
+    tau3 = tau4 = 0.0;
+    const double n = h.total();
+    if (n <= 0.0)
+        return;
+
+    const double width = h.binWidth();
+    double b[4] = {};
+    double cumulative = 0.0;
+    for (int i = 0; i < HistogramSketch::BINS; i++) {
+        if (h.counts[i] == 0.0)
+            continue;
+        const double f0 = cumulative / n;
+        cumulative += h.counts[i];
+        const double f1 = cumulative / n;
+        const double a = (h.origin + i) * width;
+        const double slope = width / (f1 - f0);
+        double p0 = f0, p1 = f1; // f^(r+1)
+        for (int r = 0; r < 4; r++) {
+            b[r] += (a - slope * f0) * (p1 - p0) / (r + 1) + slope * (p1 * f1 - p0 * f0) / (r + 2);
+            p0 *= f0;
+            p1 *= f1;
+        }
+    }
+
+    const double l2 = 2.0 * b[1] - b[0];
+    const double l3 = 6.0 * b[2] - 6.0 * b[1] + b[0];
+    const double l4 = 20.0 * b[3] - 30.0 * b[2] + 12.0 * b[1] - b[0];
+    if (l2 <= 0.0)
+        return;
+    tau3 = l3 / l2;
+    tau4 = l4 / l2;
+}
+
+// Medcouple по корзинам: центры непустых корзин (не больше 512 групп)
+// как взвешенные точки, взвешенная медиана ядра по парам xi <= med <= xj
+static double binnedMedcouple(const HistogramSketch& h) {
+    const double median = h.quantile(0.5);
+    const double width = h.binWidth();
+
+    std::vector<std::pair<double, double>> points; // (центр, вес)
+    for (int i = 0; i < HistogramSketch::BINS; i++)
+        if (h.counts[i] != 0.0)
+            points.emplace_back((h.origin + i + 0.5) * width, h.counts[i]);
+    if (points.size() < 2)
+        return 0.0;
+
+    const size_t group = (points.size() + 511) / 512;
+    std::vector<std::pair<double, double>> below, above;
+    for (size_t k = 0; k < points.size(); k += group) {
+        double weight = 0.0, center = 0.0;
+        for (size_t i = k; i < std::min(points.size(), k + group); i++) {
+            weight += points[i].second;
+            center += points[i].first * points[i].second;
+        }
+        center /= weight;
+        if (center <= median)
+            below.emplace_back(center, weight);
+        if (center >= median)
+            above.emplace_back(center, weight);
+    }
+
+    std::vector<std::pair<double, double>> kernel; // (h, вес пары)
+    kernel.reserve(below.size() * above.size());
+    double total_weight = 0.0;
+    for (const auto& [xi, wi] : below) {
+        for (const auto& [xj, wj] : above) {
+            if (xj <= xi)
+                continue;
+            kernel.emplace_back(((xj - median) - (median - xi)) / (xj - xi), wi * wj);
+            total_weight += wi * wj;
+        }
+    }
+    if (kernel.empty())
+        return 0.0;
+
+    std::sort(kernel.begin(), kernel.end());
+    double cumulative = 0.0;
+    for (const auto& [value, weight] : kernel) {
+        cumulative += weight;
+        if (cumulative >= total_weight / 2)
+            return value;
+    }
+    return kernel.back().first;
+}
+
+bool parseStatistics(const std::string& list, unsigned& statistics) {
+    unsigned result = 0;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+            end = list.size();
+        const std::string name = list.substr(start, end - start);
+        if (name == "all")
+            result |= STAT_ALL;
+        else if (name == "skewness")
+            result |= STAT_SKEWNESS;
+        else if (name == "kurtosis")
+            result |= STAT_KURTOSIS;
+        else if (name == "bowley")
+            result |= STAT_BOWLEY;
+        else if (name == "medcouple")
+            result |= STAT_MEDCOUPLE;
+        else if (name == "l_skewness")
+            result |= STAT_L_SKEWNESS;
+        else if (name == "l_kurtosis")
+            result |= STAT_L_KURTOSIS;
+        else
+            return false;
+        start = end + 1;
+    }
+    statistics = result;
+    return true;
+}
+
+std::string statisticName(StatisticFlags statistic) {
+    switch (statistic) {
+    case STAT_SKEWNESS: return "skewness";
+    case STAT_KURTOSIS: return "kurtosis";
+    case STAT_BOWLEY: return "bowley";
+    case STAT_MEDCOUPLE: return "medcouple";
+    case STAT_L_SKEWNESS: return "l_skewness";
+    case STAT_L_KURTOSIS: return "l_kurtosis";
+    }
+    return "";
+}
+
+void CellStatistics::merge(const CellStatistics& other) {
+    moments.merge(other.moments);
+    histogram.merge(other.histogram);
+}
+
+double CellStatistics::value(StatisticFlags statistic) const {
+    switch (statistic) {
+    case STAT_SKEWNESS: return moments.skewness();
+    case STAT_KURTOSIS: return moments.kurtosis();
+    case STAT_BOWLEY: {
+        const double q1 = histogram.quantile(0.25);
+        const double q2 = histogram.quantile(0.50);
+        const double q3 = histogram.quantile(0.75);
+        return q3 > q1 ? (q3 + q1 - 2.0 * q2) / (q3 - q1) : 0.0;
+    }
+    case STAT_MEDCOUPLE: return binnedMedcouple(histogram);
+    case STAT_L_SKEWNESS:
+    case STAT_L_KURTOSIS: {
+        double tau3, tau4;
+        lMomentRatios(histogram, tau3, tau4);
+        return statistic == STAT_L_SKEWNESS ? tau3 : tau4;
+    }
+    }
+    return 0.0;
+}
+
+std::vector<CellStatistics> getChannelStatistics(const cv::Mat& image, const std::vector<Span>& spans, unsigned statistics) {
+    TRACE_SCOPE("moments.statistics");
+    const int channels = image.channels();
+    std::vector<MomentSummary> moments(channels);
+    std::vector<HistogramSketch> histograms(channels);
+    const bool with_histogram = (statistics & ~STAT_MOMENTS) != 0;
+    accumulateImage(image, spans, moments.data(), with_histogram ? histograms.data() : nullptr);
+
+    std::vector<CellStatistics> result(channels);
+    for (int c = 0; c < channels; c++) {
+        result[c].moments = moments[c];
+        result[c].histogram = std::move(histograms[c]);
+    }
+    return result;
+}
+
+cv::Mat getBatchMoments(const std::vector<cv::Mat>& images, const std::vector<std::vector<Span>>& cells) {
+    CV_Assert(!images.empty());
+    for (const cv::Mat& image : images)
+        CV_Assert(image.size() == images[0].size() && image.type() == images[0].type());
+
+    const int n_images = static_cast<int>(images.size());
+    const int n_channels = images[0].channels();
+    const int n_cells = static_cast<int>(cells.size());
+    const int sizes[] = {n_images, n_channels, n_cells};
+    cv::Mat result(3, sizes, CV_64FC2, cv::Scalar(0.0));
+
+    // Задачи (изображение, ячейка) независимы и пишут в разные элементы тензора
+    cv::parallel_for_(cv::Range(0, n_images * n_cells), [&](const cv::Range& range) {
+        for (int task = range.start; task < range.end; task++) {
+            const int i = task / n_cells;
+            const int k = task % n_cells;
+            std::vector<MomentSummary> moments = getChannelMoments(images[i], cells[k]);
+            for (int c = 0; c < n_channels; c++) {
+                const int idx[] = {i, c, k};
+                result.at<cv::Vec2d>(idx) = cv::Vec2d(moments[c].skewness(), moments[c].kurtosis());
+            }
+        }
+    });
+    return result;
+}
+
+cv::Mat getBatchMoments(const cv::Mat& batch, const std::vector<std::vector<Span>>& cells) {
+    CV_Assert(batch.dims == 3);
+
+    // Плоскости 3D Mat — представления без копирования
+    std::vector<cv::Mat> images;
+    for (int i = 0; i < batch.size[0]; i++) {
+        images.emplace_back(batch.size[1], batch.size[2], batch.type(),
+                            const_cast<uchar*>(batch.ptr(i)), batch.step[1]);
+    }
+    return getBatchMoments(images, cells);
+}
+
+static double pixelValue(const cv::Mat& image, int y, int x) {
+    switch (image.depth()) {
+    case CV_8U: return image.at<uchar>(y, x);
+    case CV_16U: return image.at<ushort>(y, x);
+    case CV_16S: return image.at<short>(y, x);
+    case CV_16F: return static_cast<float>(image.at<cv::float16_t>(y, x));
+    case CV_32F: return image.at<float>(y, x);
+    case CV_64F: return image.at<double>(y, x);
+    default: CV_Error(cv::Error::StsUnsupportedFormat, "Unsupported image depth");
+    }
+}
+
+// Стандартная ошибка оценки по разбросу оценок независимых подгрупп
+static double groupStdError(const std::vector<double>& estimates) {
+    double mean = 0.0;
+    for (double e : estimates)
+        mean += e;
+    mean /= estimates.size();
+    double sum2 = 0.0;
+    for (double e : estimates)
+        sum2 += (e - mean) * (e - mean);
+    return std::sqrt(sum2 / (estimates.size() - 1)) / std::sqrt(static_cast<double>(estimates.size()));
+}
+
+ApproxMoments getApproxMoments(const cv::Mat& image, const std::vector<Span>& spans, const ApproxOptions& options) {
+    TRACE_SCOPE("moments.approx");
+    CV_Assert(image.channels() == 1);
+    CV_Assert(options.groups >= 2);
+
+    // Линейная нумерация пикселей объединения отрезков
+    std::vector<long long> offsets(spans.size() + 1, 0);
+    for (size_t i = 0; i < spans.size(); i++)
+        offsets[i + 1] = offsets[i] + std::max(spans[i].x1 - spans[i].x0, 0);
+    const long long total = offsets.back();
+    CV_Assert(total > 0);
+
+    auto exact = [&]() {
+        MomentSummary m = getChannelMoments(image, spans)[0];
+        return ApproxMoments{m.skewness(), m.kurtosis(), 0.0, 0.0, total, true};
+    };
+
+    // Страты — равные отрезки линейной нумерации, т.е. полосы ROI; за один
+    // раунд из каждой страты берётся по случайному пикселю
+    const long long groups = options.groups;
+    long long strata = std::max<long long>(groups * 64, std::llround(options.initial_fraction * total));
+    strata = (strata + groups - 1) / groups * groups;
+    if (strata >= total)
+        return exact();
+    const long long budget = std::llround(options.max_fraction * total);
+    // Первый раунд не выходит за бюджет; меньше одного пикселя на подгруппу нельзя
+    strata = std::max(groups, std::min(strata, budget / groups * groups));
+
+    // Подгруппа пикселя — номер страты по модулю groups: каждая подгруппа
+    // равномерно покрывает всю ROI
+    std::vector<MomentSummary> group_moments(groups);
+    cv::RNG rng(options.seed);
+    long long samples = 0;
+    int rounds = 0;
+    int next_check = 1;
+
+    // Раунд копится степенными суммами, сдвинутыми на первое значение
+    // подгруппы (как в accumulateRow), и сливается в group_moments один раз
+    std::vector<double> shift(groups), s1(groups), s2(groups), s3(groups), s4(groups);
+
+    while (true) {
+        std::fill(s1.begin(), s1.end(), 0.0);
+        std::fill(s2.begin(), s2.end(), 0.0);
+        std::fill(s3.begin(), s3.end(), 0.0);
+        std::fill(s4.begin(), s4.end(), 0.0);
+        for (long long j = 0; j < strata; j++) {
+            const long long lo = j * total / strata;
+            const long long hi = (j + 1) * total / strata;
+            const long long index = std::min(hi - 1, lo + static_cast<long long>(rng.uniform(0.0, 1.0) * (hi - lo)));
+
+            const size_t s = std::upper_bound(offsets.begin(), offsets.end(), index) - offsets.begin() - 1;
+            const int x = spans[s].x0 + static_cast<int>(index - offsets[s]);
+
+            const long long g = j % groups;
+            const double value = pixelValue(image, spans[s].y, x);
+            if (j < groups)
+                shift[g] = value;
+            const double d = value - shift[g];
+            const double d2 = d * d;
+            s1[g] += d;
+            s2[g] += d2;
+            s3[g] += d2 * d;
+            s4[g] += d2 * d2;
+        }
+        const double per_group = static_cast<double>(strata / groups);
+        for (long long g = 0; g < groups; g++)
+            group_moments[g].merge(fromShiftedSums(per_group, shift[g], s1[g], s2[g], s3[g], s4[g]));
+        samples += strata;
+        rounds++;
+
+        const bool budget_left = samples + strata <= budget;
+        // Проверка сходимости после удвоения подвыборки
+        if (rounds < next_check && budget_left)
+            continue;
+        next_check *= 2;
+
+        MomentSummary pooled;
+        std::vector<double> skew(groups), kurt(groups);
+        for (long long g = 0; g < groups; g++) {
+            pooled.merge(group_moments[g]);
+            skew[g] = group_moments[g].skewness();
+            kurt[g] = group_moments[g].kurtosis();
+        }
+
+        ApproxMoments result{pooled.skewness(), pooled.kurtosis(), groupStdError(skew), groupStdError(kurt), samples, false};
+        result.converged = result.skewness_error <= options.tolerance && result.kurtosis_error <= options.tolerance;
+        if (result.converged)
+            return result;
+        if (!budget_left)
+            return options.max_fraction >= 1.0 ? exact() : result;
+    }
+}
+
+ApproxMoments getApproxMoments(const cv::Mat& image, const cv::Mat& mask, const ApproxOptions& options) {
+    CV_Assert(image.size() == mask.size());
+    return getApproxMoments(image, maskToSpans(mask), options);
+}
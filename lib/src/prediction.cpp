@@ -0,0 +1,59 @@
+#include "prediction.h"
+#include <algorithm>
+#include <cmath>
+
+Cumulants signalCumulants(int distribution, double mean, double stddev)
+{
+    if (distribution == 1)
+    {
+        const double var = stddev * stddev;
+        return {var, 0.0, -1.2 * var * var};
+    }
+    if (distribution == 2)
+    {
+        // Экспоненциальное: k_n = (n-1)! * mean^n, stddev не участвует
+        const double m2 = mean * mean;
+        return {m2, 2.0 * m2 * mean, 6.0 * m2 * m2};
+    }
+    return {stddev * stddev, 0.0, 0.0};
+}
+
+double noiseStddev(double signal_variance, double snr_db)
+{
+    const double snr_linear = std::pow(10.0, snr_db / 10.0);
+    return std::sqrt(signal_variance / snr_linear);
+}
+
+PredictedMoments predictNoisyMoments(const Cumulants &signal, double noise_stddev)
+{
+    const double k2 = std::max(signal.k2 + noise_stddev * noise_stddev, 1e-20);
+    return {signal.k3 / std::pow(k2, 1.5), signal.k4 / (k2 * k2)};
+}
+
+PredictedMoments predictCellMoments(int distribution, double mean, double stddev, double snr_db)
+{
+    return predictNoisyMoments(signalCumulants(distribution, mean, stddev),
+                               noiseStddev(stddev * stddev, snr_db));
+}
+
+std::vector<PredictedMoments> predictCollageMoments(int distribution, double snr_db,
+                                                    const std::vector<CellSpec> &cells, double roi_fraction)
+{
+    // Дисперсия смеси: ячейки с весом roi_fraction и фон 0 с остальным весом
+    double ex = 0.0, ex2 = 0.0;
+    std::vector<Cumulants> signals;
+    for (const CellSpec &cell : cells)
+    {
+        Cumulants c = signalCumulants(distribution, cell.mean, cell.stddev);
+        ex += roi_fraction * cell.mean;
+        ex2 += roi_fraction * (c.k2 + cell.mean * cell.mean);
+        signals.push_back(c);
+    }
+    const double image_variance = ex2 - ex * ex;
+    const double sn = noiseStddev(image_variance, snr_db);
+
+    std::vector<PredictedMoments> result;
+    for (const Cumulants &c : signals)
+        result.push_back(predictNoisyMoments(c, sn));
+    return result;
+}
@@ -0,0 +1,371 @@
+#include "report.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    const int MARGIN = 100;
+    const size_t MAX_LEGEND_ENTRIES = 12;
+
+    // Диапазоны осей и шаг делений; считаются только по конечным значениям
+    struct Axes
+    {
+        double x_min = 0.0, x_max = 1.0, x_step = 0.2;
+        double y_min = 0.0, y_max = 1.0, y_step = 0.2;
+    };
+
+    // Шаг 1, 2 или 5 * 10^k, дающий около target делений: число делений
+    // ограничено при любом диапазоне данных
+    double niceStep(double range, int target)
+    {
+        const double raw = range / target;
+        const double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+        for (double factor : {1.0, 2.0, 5.0})
+            if (factor * magnitude >= raw)
+                return factor * magnitude;
+        return 10.0 * magnitude;
+    }
+
+    Axes computeAxes(const ReportPlot &plot)
+    {
+        double x_min = INFINITY, x_max = -INFINITY, y_max = -INFINITY, y_min = 0.0;
+        for (const ReportSeries &s : plot.series)
+        {
+            for (size_t i = 0; i < std::min(s.x.size(), s.y.size()); i++)
+            {
+                if (!std::isfinite(s.x[i]) || !std::isfinite(s.y[i]))
+                    continue;
+                x_min = std::min(x_min, s.x[i]);
+                x_max = std::max(x_max, s.x[i]);
+                y_min = std::min(y_min, s.y[i]);
+                y_max = std::max(y_max, s.y[i]);
+            }
+        }
+
+        Axes axes;
+        if (x_min > x_max)
+            return axes;
+        if (x_max - x_min < 1e-12)
+            x_max = x_min + 1.0;
+        if (y_max - y_min < 1e-12)
+            y_max = y_min + 1.0;
+
+        // Запас 10% сверху, как на прежнем графике ass
+        y_max += 0.1 * (y_max - y_min);
+
+        axes.x_min = x_min;
+        axes.x_max = x_max;
+        axes.x_step = niceStep(x_max - x_min, 5);
+        axes.y_min = y_min;
+        axes.y_max = y_max;
+        axes.y_step = niceStep(y_max - y_min, 8);
+        return axes;
+    }
+
+    std::string formatTick(double value)
+    {
+        std::ostringstream out;
+        out << std::round(value * 1000.0) / 1000.0;
+        return out.str();
+    }
+
+    // Общая геометрия для растрового и SVG-вывода
+    class PlotFrame
+    {
+    public:
+        PlotFrame(const ReportPlot &plot, int width, int height)
+            : axes(computeAxes(plot)), width(width), height(height) {}
+
+        cv::Point2d toPixel(double x, double y) const
+        {
+            const double px = MARGIN + (x - axes.x_min) / (axes.x_max - axes.x_min) * (width - 2 * MARGIN);
+            const double py = height - MARGIN - (y - axes.y_min) / (axes.y_max - axes.y_min) * (height - 2 * MARGIN);
+            return {px, py};
+        }
+
+        std::vector<double> xTicks() const { return ticks(axes.x_min, axes.x_max, axes.x_step); }
+        std::vector<double> yTicks() const { return ticks(axes.y_min, axes.y_max, axes.y_step); }
+
+        // Отрезки ломаной без точек с нечисловыми значениями
+        static std::vector<std::vector<cv::Point2d>> polylines(const ReportSeries &s, const PlotFrame &frame)
+        {
+            std::vector<std::vector<cv::Point2d>> result(1);
+            for (size_t i = 0; i < std::min(s.x.size(), s.y.size()); i++)
+            {
+                if (!std::isfinite(s.x[i]) || !std::isfinite(s.y[i]))
+                {
+                    if (!result.back().empty())
+                        result.emplace_back();
+                    continue;
+                }
+                result.back().push_back(frame.toPixel(s.x[i], s.y[i]));
+            }
+            return result;
+        }
+
+        Axes axes;
+        int width;
+        int height;
+
+    private:
+        static std::vector<double> ticks(double from, double to, double step)
+        {
+            std::vector<double> result;
+            for (double v = std::ceil(from / step) * step; v <= to + step * 1e-9; v += step)
+                result.push_back(std::fabs(v) < step * 1e-9 ? 0.0 : v);
+            return result;
+        }
+    };
+
+    std::string svgColor(const cv::Scalar &bgr)
+    {
+        return "rgb(" + std::to_string(static_cast<int>(bgr[2])) + "," + std::to_string(static_cast<int>(bgr[1])) + "," +
+               std::to_string(static_cast<int>(bgr[0])) + ")";
+    }
+
+    std::string escapeXml(const std::string &text)
+    {
+        std::string result;
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '&': result += "&amp;"; break;
+            case '<': result += "&lt;"; break;
+            case '>': result += "&gt;"; break;
+            case '"': result += "&quot;"; break;
+            default: result += c;
+            }
+        }
+        return result;
+    }
+
+    std::string extension(ReportFormat format)
+    {
+        return format == ReportFormat::Svg ? ".svg" : ".png";
+    }
+}
+
+bool parseReportFormat(const std::string &name, ReportFormat &format)
+{
+    if (name == "png")
+        format = ReportFormat::Png;
+    else if (name == "svg")
+        format = ReportFormat::Svg;
+    else
+        return false;
+    return true;
+}
+
+cv::Scalar seriesColor(size_t index)
+{
+    static const std::vector<cv::Scalar> palette = {
+        cv::Scalar(0, 0, 255),     // Красный
+        cv::Scalar(0, 165, 255),   // Оранжевый
+        cv::Scalar(0, 160, 0),     // Зеленый
+        cv::Scalar(255, 0, 0),     // Синий
+        cv::Scalar(180, 0, 180),   // Фиолетовый
+        cv::Scalar(128, 128, 0),   // Бирюзовый
+        cv::Scalar(0, 90, 140),    // Коричневый
+        cv::Scalar(100, 100, 100)  // Серый
+    };
+    return palette[index % palette.size()];
+}
+
+cv::Mat renderPlot(const ReportPlot &plot, int width, int height)
+{
+    const PlotFrame frame(plot, width, height);
+    cv::Mat image(height, width, CV_8UC3, cv::Scalar(255, 255, 255));
+    const cv::Scalar black(0, 0, 0);
+
+    // Оси и деления
+    cv::line(image, cv::Point(MARGIN, height - MARGIN), cv::Point(width - MARGIN, height - MARGIN), black, 2);
+    cv::line(image, cv::Point(MARGIN, height - MARGIN), cv::Point(MARGIN, MARGIN), black, 2);
+    for (double x : frame.xTicks())
+    {
+        cv::Point p = frame.toPixel(x, frame.axes.y_min);
+        cv::line(image, p + cv::Point(0, -5), p + cv::Point(0, 5), black, 2);
+        cv::putText(image, formatTick(x), p + cv::Point(-10, 30), cv::FONT_HERSHEY_SIMPLEX, 0.6, black, 1, cv::LINE_AA);
+    }
+    for (double y : frame.yTicks())
+    {
+        cv::Point p = frame.toPixel(frame.axes.x_min, y);
+        cv::line(image, p + cv::Point(-5, 0), p + cv::Point(5, 0), black, 1);
+        cv::putText(image, formatTick(y), p + cv::Point(-90, 5), cv::FONT_HERSHEY_SIMPLEX, 0.6, black, 1, cv::LINE_AA);
+    }
+    cv::putText(image, plot.x_label, cv::Point(width / 2 - 50, height - 20), cv::FONT_HERSHEY_SIMPLEX, 0.7, black, 2, cv::LINE_AA);
+    cv::putText(image, plot.y_label, cv::Point(10, MARGIN - 20), cv::FONT_HERSHEY_SIMPLEX, 0.7, black, 2, cv::LINE_AA);
+    cv::putText(image, plot.title, cv::Point(MARGIN, 40), cv::FONT_HERSHEY_SIMPLEX, 1.0, black, 2, cv::LINE_AA);
+
+    // Серии
+    for (const ReportSeries &s : plot.series)
+    {
+        for (const auto &segment : PlotFrame::polylines(s, frame))
+        {
+            for (size_t i = 0; i + 1 < segment.size(); i++)
+                cv::line(image, segment[i], segment[i + 1], s.color, 2, cv::LINE_AA);
+            for (const cv::Point2d &p : segment)
+                cv::circle(image, p, 5, s.color, -1, cv::LINE_AA);
+        }
+    }
+
+    // Легенда
+    const size_t entries = std::min(plot.series.size(), MAX_LEGEND_ENTRIES);
+    if (entries > 0)
+    {
+        const cv::Rect box(width - 300, 50, 250, 30 * static_cast<int>(entries) + 20);
+        cv::rectangle(image, box, cv::Scalar(230, 230, 230), -1);
+        cv::rectangle(image, box, black, 1);
+        for (size_t i = 0; i < entries; i++)
+        {
+            const int y = box.y + 25 + 30 * static_cast<int>(i);
+            const std::string label = i + 1 == MAX_LEGEND_ENTRIES && plot.series.size() > entries
+                                          ? "..." : plot.series[i].label;
+            cv::line(image, cv::Point(box.x + 20, y), cv::Point(box.x + 60, y), plot.series[i].color, 2);
+            cv::putText(image, label, cv::Point(box.x + 80, y + 5), cv::FONT_HERSHEY_SIMPLEX, 0.6, black, 1, cv::LINE_AA);
+        }
+    }
+    return image;
+}
+
+std::string renderPlotSvg(const ReportPlot &plot, int width, int height)
+{
+    const PlotFrame frame(plot, width, height);
+    std::ostringstream svg;
+    svg << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width << "\" height=\"" << height
+        << "\" font-family=\"sans-serif\">\n"
+        << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n";
+
+    svg << "<path d=\"M" << MARGIN << " " << MARGIN << " V" << height - MARGIN << " H" << width - MARGIN
+        << "\" stroke=\"black\" stroke-width=\"2\" fill=\"none\"/>\n";
+    for (double x : frame.xTicks())
+    {
+        cv::Point2d p = frame.toPixel(x, frame.axes.y_min);
+        svg << "<line x1=\"" << p.x << "\" y1=\"" << p.y - 5 << "\" x2=\"" << p.x << "\" y2=\"" << p.y + 5
+            << "\" stroke=\"black\"/>\n"
+            << "<text x=\"" << p.x << "\" y=\"" << p.y + 30 << "\" text-anchor=\"middle\" font-size=\"16\">"
+            << formatTick(x) << "</text>\n";
+    }
+    for (double y : frame.yTicks())
+    {
+        cv::Point2d p = frame.toPixel(frame.axes.x_min, y);
+        svg << "<line x1=\"" << p.x - 5 << "\" y1=\"" << p.y << "\" x2=\"" << p.x + 5 << "\" y2=\"" << p.y
+            << "\" stroke=\"black\"/>\n"
+            << "<text x=\"" << p.x - 10 << "\" y=\"" << p.y + 5 << "\" text-anchor=\"end\" font-size=\"16\">"
+            << formatTick(y) << "</text>\n";
+    }
+    svg << "<text x=\"" << width / 2 << "\" y=\"" << height - 20 << "\" text-anchor=\"middle\" font-size=\"18\">"
+        << escapeXml(plot.x_label) << "</text>\n"
+        << "<text x=\"10\" y=\"" << MARGIN - 20 << "\" font-size=\"18\">" << escapeXml(plot.y_label) << "</text>\n"
+        << "<text x=\"" << MARGIN << "\" y=\"40\" font-size=\"26\">" << escapeXml(plot.title) << "</text>\n";
+
+    for (const ReportSeries &s : plot.series)
+    {
+        const std::string color = svgColor(s.color);
+        for (const auto &segment : PlotFrame::polylines(s, frame))
+        {
+            if (segment.empty())
+                continue;
+            svg << "<polyline fill=\"none\" stroke=\"" << color << "\" stroke-width=\"2\" points=\"";
+            for (const cv::Point2d &p : segment)
+                svg << p.x << "," << p.y << " ";
+            svg << "\"/>\n";
+            for (const cv::Point2d &p : segment)
+                svg << "<circle cx=\"" << p.x << "\" cy=\"" << p.y << "\" r=\"4\" fill=\"" << color << "\"/>\n";
+        }
+    }
+
+    const size_t entries = std::min(plot.series.size(), MAX_LEGEND_ENTRIES);
+    if (entries > 0)
+    {
+        const int x = width - 300;
+        svg << "<rect x=\"" << x << "\" y=\"50\" width=\"250\" height=\"" << 30 * entries + 20
+            << "\" fill=\"rgb(230,230,230)\" stroke=\"black\"/>\n";
+        for (size_t i = 0; i < entries; i++)
+        {
+            const int y = 75 + 30 * static_cast<int>(i);
+            const std::string label = i + 1 == MAX_LEGEND_ENTRIES && plot.series.size() > entries
+                                          ? "..." : plot.series[i].label;
+            svg << "<line x1=\"" << x + 20 << "\" y1=\"" << y << "\" x2=\"" << x + 60 << "\" y2=\"" << y
+                << "\" stroke=\"" << svgColor(plot.series[i].color) << "\" stroke-width=\"2\"/>\n"
+                << "<text x=\"" << x + 80 << "\" y=\"" << y + 5 << "\" font-size=\"16\">" << escapeXml(label)
+                << "</text>\n";
+        }
+    }
+
+    svg << "</svg>\n";
+    return svg.str();
+}
+
+int writeReport(const std::vector<ReportPlot> &plots, const ReportOptions &options)
+{
+    TRACE_SCOPE("report.write");
+    fs::create_directories(options.directory);
+
+    // Каждый график пишется в свой файл, общих данных у потоков нет
+    std::vector<std::string> errors(plots.size());
+    cv::parallel_for_(cv::Range(0, static_cast<int>(plots.size())), [&](const cv::Range &range)
+                      {
+        for (int i = range.start; i < range.end; i++)
+        {
+            TRACE_SCOPE("report.plot");
+            const ReportPlot &plot = plots[i];
+            const fs::path path = fs::path(options.directory) / (plot.name + extension(options.format));
+            try
+            {
+                if (options.format == ReportFormat::Svg)
+                {
+                    std::ofstream out(path);
+                    out << renderPlotSvg(plot, options.width, options.height);
+                    if (!out)
+                        errors[i] = "Failed to write " + path.string();
+                }
+                else if (!cv::imwrite(path.string(), renderPlot(plot, options.width, options.height)))
+                {
+                    errors[i] = "Failed to write " + path.string();
+                }
+            }
+            catch (const std::exception &e)
+            {
+                errors[i] = e.what();
+            }
+        } });
+
+    // index.html: разделы в порядке первого появления
+    std::vector<std::string> sections;
+    for (const ReportPlot &plot : plots)
+        if (std::find(sections.begin(), sections.end(), plot.section) == sections.end())
+            sections.push_back(plot.section);
+
+    std::ofstream index(fs::path(options.directory) / "index.html");
+    index << "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>Assessment report</title>\n"
+          << "<style>body{font-family:sans-serif} figure{display:inline-block;margin:8px} "
+          << "img{width:600px} .error{color:red}</style></head><body>\n"
+          << "<h1>Assessment report</h1>\n";
+    int written = 0;
+    for (const std::string &section : sections)
+    {
+        index << "<h2>" << escapeXml(section) << "</h2>\n";
+        for (size_t i = 0; i < plots.size(); i++)
+        {
+            if (plots[i].section != section)
+                continue;
+            if (!errors[i].empty())
+            {
+                index << "<p class=\"error\">" << escapeXml(plots[i].title) << ": " << escapeXml(errors[i]) << "</p>\n";
+                continue;
+            }
+            index << "<figure><img src=\"" << escapeXml(plots[i].name + extension(options.format)) << "\"><figcaption>"
+                  << escapeXml(plots[i].title) << "</figcaption></figure>\n";
+            written++;
+        }
+    }
+    index << "</body></html>\n";
+    return written;
+}
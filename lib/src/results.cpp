@@ -0,0 +1,262 @@
+#include "results.h"
+#include "trace.h"
+#include <filesystem>
+#include <istream>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+NdjsonWriter::NdjsonWriter(const std::string &path)
+    : out(path)
+{
+}
+
+void NdjsonWriter::write(const json &line)
+{
+    TRACE_SCOPE("file.write");
+    out << line.dump() << '\n';
+}
+
+namespace
+{
+    // Поле ячейки по имени ключа; nullptr для ненужных полей
+    double *recordField(CellRecord &record, const std::string &key)
+    {
+        if (key == "evaluated_skewness")
+            return &record.evaluated_skewness;
+        if (key == "evaluated_kurtosis")
+            return &record.evaluated_kurtosis;
+        if (key == "theoretical_skewness")
+            return &record.theoretical_skewness;
+        if (key == "theoretical_kurtosis")
+            return &record.theoretical_kurtosis;
+        if (key == "predicted_skewness")
+            return &record.predicted_skewness;
+        if (key == "predicted_kurtosis")
+            return &record.predicted_kurtosis;
+        if (key == "mean")
+            return &record.mean;
+        if (key == "stddev")
+            return &record.stddev;
+        return nullptr;
+    }
+
+    double *intervalField(CellRecord &record, const std::string &key)
+    {
+        if (key == "skewness_ci")
+            return record.skewness_ci;
+        if (key == "kurtosis_ci")
+            return record.kurtosis_ci;
+        return nullptr;
+    }
+
+    // Обработчик SAX: хранит только путь от корня до текущего значения
+    // и поля одной ячейки. Ячейка — объект верхнего уровня (строка NDJSON),
+    // элемент массива "cells" (eval) или элемент вложенного массива (gt)
+    class CellSaxHandler : public nlohmann::json_sax<json>
+    {
+    public:
+        explicit CellSaxHandler(const std::function<void(const CellRecord &)> &cell)
+            : emit(cell)
+        {
+        }
+
+        bool null() override { return scalar(NAN); }
+        bool boolean(bool) override { return scalar(NAN); }
+        bool number_integer(number_integer_t value) override { return scalar(static_cast<double>(value)); }
+        bool number_unsigned(number_unsigned_t value) override { return scalar(static_cast<double>(value)); }
+        bool number_float(number_float_t value, const string_t &) override { return scalar(value); }
+        bool string(string_t &) override { return scalar(NAN); }
+        bool binary(binary_t &) override { return scalar(NAN); }
+
+        bool key(string_t &value) override
+        {
+            stack.back().key = value;
+            return true;
+        }
+
+        bool start_object(std::size_t) override
+        {
+            const int depth = static_cast<int>(stack.size());
+            const bool in_cells = depth >= 2 && stack[0].key == "cells";
+            if (depth == 0 || (in_cells && depth <= 3 && stack.back().array))
+            {
+                record = CellRecord();
+                if (depth == 3)
+                {
+                    record.row = stack[1].index;
+                    record.column = stack[2].index;
+                }
+                cell_depth = depth;
+            }
+            stack.push_back({false, 0, ""});
+            return true;
+        }
+
+        bool end_object() override
+        {
+            stack.pop_back();
+            // Заголовок NDJSON и корень документа без row ячейками не считаются
+            if (static_cast<int>(stack.size()) == cell_depth)
+            {
+                if (record.row >= 0 && record.column >= 0)
+                    emit(record);
+                cell_depth = -1;
+            }
+            return next();
+        }
+
+        bool start_array(std::size_t) override
+        {
+            interval = static_cast<int>(stack.size()) == cell_depth + 1 ? intervalField(record, stack.back().key) : nullptr;
+            stack.push_back({true, 0, ""});
+            return true;
+        }
+
+        bool end_array() override
+        {
+            stack.pop_back();
+            interval = nullptr;
+            return next();
+        }
+
+        bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &) override
+        {
+            return false;
+        }
+
+    private:
+        struct Frame
+        {
+            bool array;
+            int index;       // номер текущего элемента массива
+            std::string key; // последний ключ объекта
+        };
+
+        bool scalar(double value)
+        {
+            const int depth = static_cast<int>(stack.size());
+            if (cell_depth >= 0 && depth == cell_depth + 1)
+            {
+                const std::string &name = stack.back().key;
+                if (name == "row")
+                    record.row = static_cast<int>(value);
+                else if (name == "column")
+                    record.column = static_cast<int>(value);
+                else if (double *field = recordField(record, name))
+                    *field = value;
+            }
+            else if (interval && depth == cell_depth + 2 && stack.back().index < 2)
+            {
+                interval[stack.back().index] = value;
+            }
+            return next();
+        }
+
+        // Переход к следующему элементу массива
+        bool next()
+        {
+            if (!stack.empty() && stack.back().array)
+                stack.back().index++;
+            return true;
+        }
+
+        const std::function<void(const CellRecord &)> &emit;
+        std::vector<Frame> stack;
+        CellRecord record;
+        int cell_depth = -1;
+        double *interval = nullptr;
+    };
+}
+
+CellRecord cellRecordFromJson(const json &cell, int row, int column)
+{
+    CellRecord record;
+    record.row = cell.value("row", row);
+    record.column = cell.value("column", column);
+    for (const auto &[key, value] : cell.items())
+    {
+        if (value.is_number())
+        {
+            if (double *field = recordField(record, key))
+                *field = value.get<double>();
+        }
+        else if (value.is_array() && value.size() == 2 && value[0].is_number() && value[1].is_number())
+        {
+            if (double *interval = intervalField(record, key))
+            {
+                interval[0] = value[0].get<double>();
+                interval[1] = value[1].get<double>();
+            }
+        }
+    }
+    return record;
+}
+
+bool readCellRecords(const std::string &path, const std::function<void(const CellRecord &)> &cell)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+        return false;
+
+    TRACE_SCOPE("json.sax");
+    // Без strict разбор останавливается после первого значения, поэтому
+    // один цикл читает и обычный JSON, и последовательность строк NDJSON
+    CellSaxHandler handler(cell);
+    while (in >> std::ws && in.peek() != std::char_traits<char>::eof())
+    {
+        if (!json::sax_parse(in, &handler, json::input_format_t::json, false))
+            return false;
+    }
+    return true;
+}
+
+json readResultDocument(const std::string &path)
+{
+    std::ifstream in(path);
+    if (!in.is_open())
+        throw std::runtime_error("Error opening: " + path);
+
+    // NDJSON узнаётся по содержимому, а не только по расширению (eval --ndjson
+    // пишет в путь, выбранный пользователем): первая строка — законченный
+    // объект без row, и за ней есть ещё значения либо "cells" в нём нет или
+    // это число ячеек (NDJSON без ячеек). Форматированный JSON на первой
+    // строке не разбирается
+    std::string line;
+    std::getline(in, line);
+    json header = json::parse(line, nullptr, false);
+    const bool header_line = header.is_object() && !header.contains("row");
+    const bool has_more = (in >> std::ws) && in.peek() != std::char_traits<char>::eof();
+    if (fs::path(path).extension() != ".ndjson" && !(header_line && (has_more || !header.contains("cells") || header["cells"].is_number())))
+    {
+        in.clear();
+        in.seekg(0);
+        json document = json::parse(in);
+        if (document.is_object() && !document.contains("cells"))
+            document["cells"] = json::array();
+        return document;
+    }
+
+    json document = json::object();
+    json cells = json::array();
+    if (header.is_object())
+    {
+        if (header.contains("row"))
+            cells.push_back(std::move(header));
+        else
+            document.update(header);
+    }
+    while (std::getline(in, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        json value = json::parse(line);
+        if (value.contains("row"))
+            cells.push_back(std::move(value));
+        else
+            document.update(value);
+    }
+    document["cells"] = std::move(cells);
+    return document;
+}
@@ -0,0 +1,414 @@
+#include "server.h"
+#include "evaluator.h"
+#include "storage.h"
+#include "trace.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    std::atomic<bool> stop_requested{false};
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    sockaddr_un socketAddress(const std::string &path)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Socket path is too long: " + path);
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        return addr;
+    }
+
+    bool sendAll(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // Предел длины строки запроса: клиент без '\n' не растит буфер бесконечно
+    constexpr size_t MAX_LINE_BYTES = 4 << 20;
+
+    // Чтение одной строки; buffer хранит остаток после '\n' между вызовами.
+    // false — соединение закрыто или строка длиннее MAX_LINE_BYTES
+    bool readLine(int fd, std::string &buffer, std::string &line)
+    {
+        for (;;)
+        {
+            size_t newline = buffer.find('\n');
+            if (newline != std::string::npos)
+            {
+                line = buffer.substr(0, newline);
+                buffer.erase(0, newline + 1);
+                return true;
+            }
+            if (buffer.size() > MAX_LINE_BYTES)
+                return false;
+            char chunk[4096];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+    int parseFrameType(const std::string &type)
+    {
+        if (type == "f32")
+            return CV_32FC1;
+        if (type == "f16")
+            return CV_16FC1;
+        if (type == "u16")
+            return CV_16UC1;
+        if (type == "u8")
+            return CV_8UC1;
+        throw std::runtime_error("Unknown frame type: " + type + " (f32, f16, u16, u8)");
+    }
+
+    // Кадр в разделяемой памяти POSIX: отображается только на чтение,
+    // без копирования в процесс сервера
+    class SharedFrame
+    {
+    public:
+        SharedFrame(const std::string &name, size_t offset, cv::Size size, int type)
+        {
+            int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+                throw std::runtime_error("Failed to open shared memory: " + name);
+            struct stat st;
+            if (::fstat(fd, &st) != 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to stat shared memory: " + name);
+            }
+            length = static_cast<size_t>(st.st_size);
+            const size_t needed = offset + size.area() * CV_ELEM_SIZE(type);
+            if (needed > length)
+            {
+                ::close(fd);
+                throw std::runtime_error("Shared memory " + name + " is smaller than the frame");
+            }
+            address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED)
+                throw std::runtime_error("Failed to map shared memory: " + name);
+            frame = cv::Mat(size, type, static_cast<uchar *>(address) + offset);
+        }
+
+        ~SharedFrame()
+        {
+            ::munmap(address, length);
+        }
+
+        SharedFrame(const SharedFrame &) = delete;
+        SharedFrame &operator=(const SharedFrame &) = delete;
+
+        cv::Mat frame;
+
+    private:
+        void *address = nullptr;
+        size_t length = 0;
+    };
+
+    // Раскладка из прямоугольников запроса
+    CollageLayout layoutFromRects(const json &rects, cv::Size size)
+    {
+        CollageLayout layout;
+        layout.size = size;
+        const cv::Rect bounds(0, 0, size.width, size.height);
+        for (const json &r : rects)
+        {
+            CellRoi cell;
+            cell.row = r.value("row", 0);
+            cell.col = r.value("col", 0);
+            cell.bbox = cv::Rect(r.at("x").get<int>(), r.at("y").get<int>(),
+                                 r.at("width").get<int>(), r.at("height").get<int>()) &
+                        bounds;
+            for (int y = cell.bbox.y; y < cell.bbox.y + cell.bbox.height; y++)
+                cell.spans.push_back({y, cell.bbox.x, cell.bbox.x + cell.bbox.width});
+            layout.cells.push_back(std::move(cell));
+        }
+        return layout;
+    }
+
+    // Общее состояние всех соединений
+    struct ServerContext
+    {
+        const CollageLayout fixed_layout = layoutFromMask(createCollageMask());
+        LayoutCache layouts;
+
+        std::mutex stats_mutex;
+        ServerStats stats;
+
+        // Открытые соединения; потоки клиентов отсоединены и при выходе
+        // удаляют свой дескриптор, так что пустое множество — все завершились
+        std::mutex clients_mutex;
+        std::condition_variable clients_done;
+        std::set<int> client_fds;
+    };
+
+    json evaluateRequest(const json &request, ServerContext &context)
+    {
+        TRACE_SCOPE("server.request");
+        std::unique_ptr<SharedFrame> shared;
+        cv::Mat image;
+        StorageInfo storage;
+        if (request.contains("image"))
+        {
+            image = readStoredCollage(request["image"].get<std::string>(), storage);
+            if (image.empty())
+                throw std::runtime_error("Error loading: " + request["image"].get<std::string>());
+        }
+        else if (request.contains("shm"))
+        {
+            cv::Size size(request.at("width").get<int>(), request.at("height").get<int>());
+            shared = std::make_unique<SharedFrame>(request["shm"].get<std::string>(), request.value("offset", size_t(0)),
+                                                   size, parseFrameType(request.value("type", "f32")));
+            image = shared->frame;
+        }
+        else
+        {
+            throw std::runtime_error("Request needs \"image\", \"shm\" or \"command\"");
+        }
+
+        // Параметры в том же виде, что у eval; "layout" и "approx" — краткая форма.
+        // "approx" дописывается к args и проверяется вместе с ними
+        std::vector<std::string> args = request.value("args", std::vector<std::string>());
+        if (request.contains("approx"))
+        {
+            args.push_back("--approx");
+            args.push_back(request["approx"].dump());
+        }
+        EvaluationOptions options;
+        std::string error;
+        if (!parseEvaluationOptions(args, options, error))
+            throw std::runtime_error(error);
+        if (request.contains("layout_key"))
+            options.layout_key = request["layout_key"].get<std::string>();
+
+        CollageLayout custom;
+        std::shared_ptr<const CollageLayout> detected;
+        const CollageLayout *layout = &context.fixed_layout;
+        const json layout_spec = request.value("layout", json(options.auto_layout ? "auto" : "fixed"));
+        if (layout_spec.is_array())
+        {
+            custom = layoutFromRects(layout_spec, image.size());
+            layout = &custom;
+        }
+        else if (layout_spec == "auto")
+        {
+            detected = context.layouts.get(image, options.layout_key);
+            layout = detected.get();
+        }
+        else if (layout_spec != "fixed")
+        {
+            throw std::runtime_error("Unknown layout: " + layout_spec.dump());
+        }
+
+        // С "output" ячейки пишутся в файл так же, как eval (NDJSON — потоково),
+        // а в ответ уходит только их число
+        if (request.contains("output"))
+        {
+            const std::string output = request["output"].get<std::string>();
+            if (!writeEvaluation(output, image, storage, *layout, options))
+                throw std::runtime_error("Error opening output: " + output);
+            json result;
+            result["cells"] = layout->cells.size();
+            result["output"] = output;
+            return result;
+        }
+        return evaluateDocument(image, storage, *layout, options);
+    }
+
+    json handleRequest(const std::string &line, ServerContext &context)
+    {
+        const int64_t start = nowNs();
+        json response;
+        try
+        {
+            json request = json::parse(line);
+            if (request.contains("id"))
+                response["id"] = request["id"];
+
+            const std::string command = request.value("command", "");
+            if (command == "ping")
+            {
+                response["ok"] = true;
+                return response;
+            }
+            if (command == "stats")
+            {
+                std::lock_guard<std::mutex> lock(context.stats_mutex);
+                response.update(context.stats.toJson());
+                response["ok"] = true;
+                return response;
+            }
+            if (command == "shutdown")
+            {
+                requestServerStop();
+                response["ok"] = true;
+                return response;
+            }
+            if (!command.empty())
+                throw std::runtime_error("Unknown command: " + command);
+
+            // Ячейки и заголовок (storage, confidence, resampling), как в файле eval
+            response.update(evaluateRequest(request, context));
+            response["ok"] = true;
+        }
+        catch (const std::exception &e)
+        {
+            response["ok"] = false;
+            response["error"] = e.what();
+        }
+
+        const int64_t latency = nowNs() - start;
+        response["latency_us"] = latency / 1000.0;
+
+        std::lock_guard<std::mutex> lock(context.stats_mutex);
+        context.stats.requests++;
+        if (!response["ok"].get<bool>())
+            context.stats.errors++;
+        context.stats.latency.add(latency);
+        return response;
+    }
+
+    void serveClient(int fd, ServerContext &context)
+    {
+        std::string buffer, line;
+        while (!stop_requested && readLine(fd, buffer, line))
+        {
+            if (line.empty())
+                continue;
+            if (!sendAll(fd, handleRequest(line, context).dump() + "\n"))
+                break;
+        }
+
+        // Закрытие под блокировкой: иначе accept может выдать тот же номер
+        // новому клиенту до erase, и тот выпадет из client_fds
+        std::lock_guard<std::mutex> lock(context.clients_mutex);
+        context.client_fds.erase(fd);
+        ::close(fd);
+        context.clients_done.notify_all();
+    }
+}
+
+json ServerStats::toJson() const
+{
+    json j;
+    j["requests"] = requests;
+    j["errors"] = errors;
+    j["clients"] = clients;
+    j["latency"] = latency.toJson();
+    return j;
+}
+
+void requestServerStop()
+{
+    stop_requested = true;
+}
+
+ServerStats runEvalServer(const ServerOptions &options)
+{
+    stop_requested = false;
+    ServerContext context;
+
+    sockaddr_un addr = socketAddress(options.socket_path);
+    int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        throw std::runtime_error("Failed to create socket");
+    ::unlink(options.socket_path.c_str());
+    if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, options.backlog) != 0)
+    {
+        ::close(listen_fd);
+        throw std::runtime_error("Failed to listen on " + options.socket_path + ": " + std::strerror(errno));
+    }
+
+    // accept с таймаутом, чтобы замечать запрос на остановку
+    while (!stop_requested)
+    {
+        pollfd pfd{listen_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 200) <= 0)
+            continue;
+        int client_fd = ::accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+            continue;
+
+        {
+            std::lock_guard<std::mutex> lock(context.clients_mutex);
+            context.client_fds.insert(client_fd);
+        }
+        {
+            std::lock_guard<std::mutex> lock(context.stats_mutex);
+            context.stats.clients++;
+        }
+        std::thread(serveClient, client_fd, std::ref(context)).detach();
+    }
+
+    ::close(listen_fd);
+    ::unlink(options.socket_path.c_str());
+
+    // Соединения, ждущие следующего запроса, закрываются принудительно
+    {
+        std::unique_lock<std::mutex> lock(context.clients_mutex);
+        for (int fd : context.client_fds)
+            ::shutdown(fd, SHUT_RDWR);
+        context.clients_done.wait(lock, [&]
+                                  { return context.client_fds.empty(); });
+    }
+
+    return context.stats;
+}
+
+json sendServerRequest(const std::string &socket_path, const json &request)
+{
+    sockaddr_un addr = socketAddress(socket_path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("Failed to create socket");
+    if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("Failed to connect to " + socket_path + ": " + std::strerror(errno));
+    }
+
+    std::string buffer, line;
+    const bool ok = sendAll(fd, request.dump() + "\n") && readLine(fd, buffer, line);
+    ::close(fd);
+    if (!ok)
+        throw std::runtime_error("Connection to " + socket_path + " closed");
+    return json::parse(line);
+}
@@ -0,0 +1,114 @@
+#include "sketch.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+json sketchToJson(const CellStatistics &statistics, int max_bins)
+{
+    json j;
+    j["n"] = statistics.moments.n;
+    j["mean"] = statistics.moments.mean;
+    j["m2"] = statistics.moments.M2;
+    j["m3"] = statistics.moments.M3;
+    j["m4"] = statistics.moments.M4;
+    if (statistics.histogram.empty())
+        return j;
+
+    HistogramSketch h = statistics.histogram;
+    h.reduce(max_bins);
+    int first = 0, last = HistogramSketch::BINS - 1;
+    while (first < last && h.counts[first] == 0.0)
+        first++;
+    while (last > first && h.counts[last] == 0.0)
+        last--;
+
+    j["exponent"] = h.exponent;
+    j["first"] = h.origin + first;
+    j["counts"] = std::vector<double>(h.counts.begin() + first, h.counts.begin() + last + 1);
+    return j;
+}
+
+CellStatistics sketchFromJson(const json &sketch)
+{
+    CellStatistics statistics;
+    statistics.moments.n = sketch.at("n");
+    statistics.moments.mean = sketch.at("mean");
+    statistics.moments.M2 = sketch.at("m2");
+    statistics.moments.M3 = sketch.at("m3");
+    statistics.moments.M4 = sketch.at("m4");
+    if (!sketch.contains("counts"))
+        return statistics;
+
+    const std::vector<double> counts = sketch["counts"];
+    if (counts.empty() || counts.size() > static_cast<size_t>(HistogramSketch::BINS))
+        throw std::runtime_error("Invalid sketch histogram size");
+
+    // Корзины размещаются в середине окна, как после fitIndexRange
+    HistogramSketch &h = statistics.histogram;
+    h.exponent = sketch.at("exponent");
+    h.inv_width = std::ldexp(1.0, -h.exponent);
+    const long long first = sketch.at("first");
+    const int offset = (HistogramSketch::BINS - static_cast<int>(counts.size())) / 2;
+    h.origin = first - offset;
+    h.counts.assign(HistogramSketch::BINS, 0.0);
+    std::copy(counts.begin(), counts.end(), h.counts.begin() + offset);
+    return statistics;
+}
+
+int SketchPool::add(const json &evaluation)
+{
+    TRACE_SCOPE("sketch.merge");
+    int added = 0;
+    for (const json &cell : evaluation.at("cells"))
+    {
+        if (!cell.contains("sketch"))
+            continue;
+        std::vector<CellStatistics> &channels = cells[{cell.at("row").get<int>(), cell.at("column").get<int>()}];
+        const json &sketch = cell["sketch"];
+        if (channels.empty())
+            channels.resize(sketch.size());
+        if (channels.size() != sketch.size())
+            throw std::runtime_error("Sketches with different channel counts cannot be merged");
+        for (size_t c = 0; c < channels.size(); c++)
+            channels[c].merge(sketchFromJson(sketch[c]));
+        added++;
+    }
+    if (added > 0)
+        evaluations++;
+    return added;
+}
+
+json SketchPool::toJson(unsigned statistics) const
+{
+    json j_result;
+    j_result["evaluations"] = evaluations;
+    json cells_array = json::array();
+    for (const auto &[key, channels] : cells)
+    {
+        json j_cell;
+        j_cell["row"] = key.first;
+        j_cell["column"] = key.second;
+        if (channels.size() == 1)
+            j_cell["n"] = channels[0].moments.n;
+        else
+            for (const CellStatistics &c : channels)
+                j_cell["n"].push_back(c.moments.n);
+        for (unsigned bit = 1; bit <= STAT_ALL; bit <<= 1)
+        {
+            // Без гистограмм доступны только моменты
+            if (!(statistics & bit) || (!(bit & STAT_MOMENTS) && channels[0].histogram.empty()))
+                continue;
+            const StatisticFlags statistic = static_cast<StatisticFlags>(bit);
+            const std::string name = "pooled_" + statisticName(statistic);
+            if (channels.size() == 1)
+                j_cell[name] = channels[0].value(statistic);
+            else
+                for (const CellStatistics &c : channels)
+                    j_cell[name].push_back(c.value(statistic));
+        }
+        cells_array.push_back(std::move(j_cell));
+    }
+    j_result["cells"] = cells_array;
+    return j_result;
+}
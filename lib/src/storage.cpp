@@ -0,0 +1,165 @@
+#include "storage.h"
+#include "trace.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+bool parseStorageFormat(const std::string &name, StorageFormat &format)
+{
+    if (name == "float32")
+        format = StorageFormat::Float32;
+    else if (name == "float16")
+        format = StorageFormat::Float16;
+    else if (name == "scaled16")
+        format = StorageFormat::Scaled16;
+    else
+        return false;
+    return true;
+}
+
+std::string storageFormatName(StorageFormat format)
+{
+    switch (format)
+    {
+    case StorageFormat::Float16: return "float16";
+    case StorageFormat::Scaled16: return "scaled16";
+    default: return "float32";
+    }
+}
+
+std::string storageSidecarPath(const std::string &image_path)
+{
+    return image_path + ".json";
+}
+
+cv::Mat encodeCollage(const cv::Mat &collage, StorageFormat format, StorageInfo &info)
+{
+    CV_Assert(collage.depth() == CV_32F);
+    TRACE_SCOPE("storage.encode");
+    info = StorageInfo();
+    info.format = format;
+
+    cv::Mat encoded;
+    if (format == StorageFormat::Float16)
+    {
+        collage.convertTo(encoded, CV_16F);
+    }
+    else if (format == StorageFormat::Scaled16)
+    {
+        // Весь диапазон значений растягивается на [0, 65535]
+        double min_value, max_value;
+        cv::minMaxLoc(collage.reshape(1), &min_value, &max_value);
+        info.offset = min_value;
+        info.scale = max_value > min_value ? (max_value - min_value) / 65535.0 : 1.0;
+        collage.convertTo(encoded, CV_16U, 1.0 / info.scale, -info.offset / info.scale);
+    }
+    else
+    {
+        encoded = collage;
+    }
+    return encoded;
+}
+
+json writeCollage(const std::string &path, const cv::Mat &collage, StorageFormat format, const CollageLayout *layout)
+{
+    StorageInfo info;
+    cv::Mat encoded = encodeCollage(collage, format, info);
+
+    // Кодеки OpenCV не пишут CV_16F, поэтому на диск идёт тот же буфер как 16U
+    cv::Mat on_disk = encoded;
+    if (encoded.depth() == CV_16F)
+        on_disk = cv::Mat(encoded.size(), CV_16UC(encoded.channels()), encoded.data, encoded.step);
+
+    {
+        TRACE_SCOPE("io.imwrite");
+        if (!cv::imwrite(path, on_disk))
+            throw std::runtime_error("Failed to save image to: " + path);
+    }
+
+    // Устаревший файл метаданных от прежней записи в другом формате
+    // заставил бы читателя декодировать float32 как 16-битные данные
+    if (format == StorageFormat::Float32)
+    {
+        std::remove(storageSidecarPath(path).c_str());
+        return json::object();
+    }
+
+    json sidecar;
+    sidecar["format"] = storageFormatName(format);
+    sidecar["scale"] = info.scale;
+    sidecar["offset"] = info.offset;
+    if (layout)
+        sidecar["moment_error"] = storageMomentError(collage, encoded, *layout);
+
+    std::ofstream sidecar_file(storageSidecarPath(path));
+    sidecar_file << sidecar.dump(4);
+    return sidecar;
+}
+
+cv::Mat readStoredCollage(const std::string &path, StorageInfo &info)
+{
+    info = StorageInfo();
+    cv::Mat raw;
+    {
+        TRACE_SCOPE("io.imread");
+        raw = cv::imread(path, cv::IMREAD_UNCHANGED);
+    }
+    if (raw.empty())
+        return raw;
+
+    // Без файла метаданных изображение считается обычным float32
+    std::ifstream sidecar_file(storageSidecarPath(path));
+    if (!sidecar_file.is_open())
+        return raw;
+
+    json sidecar = json::parse(sidecar_file);
+    StorageInfo stored;
+    if (!parseStorageFormat(sidecar.value("format", "float32"), stored.format))
+        throw std::runtime_error("Unknown storage format in " + storageSidecarPath(path));
+    stored.scale = sidecar.value("scale", 1.0);
+    stored.offset = sidecar.value("offset", 0.0);
+
+    // Файл метаданных, не соответствующий глубине изображения, остался от
+    // другой записи и игнорируется
+    const int expected_depth = stored.format == StorageFormat::Float32 ? CV_32F : CV_16U;
+    if (raw.depth() != expected_depth)
+        return raw;
+    info = stored;
+
+    if (info.format != StorageFormat::Float16)
+        return raw;
+
+    cv::Mat half(raw.size(), CV_16FC(raw.channels()));
+    cv::Mat half_bits(half.size(), CV_16UC(half.channels()), half.data, half.step);
+    raw.copyTo(half_bits);
+    return half;
+}
+
+json storageMomentError(const cv::Mat &original, const cv::Mat &stored, const CollageLayout &layout)
+{
+    TRACE_SCOPE("storage.moment_error");
+    double max_skew = 0.0, max_kurt = 0.0, sum_skew = 0.0, sum_kurt = 0.0;
+    int count = 0;
+    for (const CellRoi &cell : layout.cells)
+    {
+        std::vector<MomentSummary> reference = getChannelMoments(original, cell.spans);
+        std::vector<MomentSummary> compact = getChannelMoments(stored, cell.spans);
+        for (size_t c = 0; c < reference.size(); c++)
+        {
+            const double skew_error = std::fabs(compact[c].skewness() - reference[c].skewness());
+            const double kurt_error = std::fabs(compact[c].kurtosis() - reference[c].kurtosis());
+            max_skew = std::max(max_skew, skew_error);
+            max_kurt = std::max(max_kurt, kurt_error);
+            sum_skew += skew_error;
+            sum_kurt += kurt_error;
+            count++;
+        }
+    }
+
+    json j;
+    j["max_skewness_error"] = max_skew;
+    j["max_kurtosis_error"] = max_kurt;
+    j["mean_skewness_error"] = count ? sum_skew / count : 0.0;
+    j["mean_kurtosis_error"] = count ? sum_kurt / count : 0.0;
+    return j;
+}
@@ -0,0 +1,420 @@
+#include "stream.h"
+#include "spsc_queue.h"
+#include "evaluator.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // Ожидание без блокировок: сначала yield, затем короткий сон
+    void backoff(int &spins)
+    {
+        if (++spins < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    class FrameSource
+    {
+    public:
+        virtual ~FrameSource() = default;
+        virtual bool read(cv::Mat &frame) = 0;
+    };
+
+    class CaptureSource : public FrameSource
+    {
+    public:
+        explicit CaptureSource(const std::string &source)
+        {
+            bool is_index = !source.empty() && std::all_of(source.begin(), source.end(), [](unsigned char c)
+                                                                           { return std::isdigit(c) != 0; });
+            if (is_index)
+                capture = cv::VideoCapture(std::stoi(source));
+            else
+                capture = cv::VideoCapture(source);
+            if (!capture.isOpened())
+                throw std::runtime_error("Failed to open video source: " + source);
+        }
+
+        bool read(cv::Mat &frame) override { return capture.read(frame); }
+
+    private:
+        cv::VideoCapture capture;
+    };
+
+    // Последовательность изображений: каталог (по алфавиту) или printf-шаблон.
+    // Читается через imread, чтобы float TIFF не приводились к 8 битам.
+    class SequenceSource : public FrameSource
+    {
+    public:
+        explicit SequenceSource(const std::string &source)
+        {
+            if (fs::is_directory(source))
+            {
+                for (const auto &entry : fs::directory_iterator(source))
+                {
+                    if (entry.is_regular_file())
+                        files.push_back(entry.path().string());
+                }
+                std::sort(files.begin(), files.end());
+            }
+            else
+            {
+                pattern = source;
+                // Нумерация может начинаться с 0 или с 1
+                if (!fs::exists(format(0)) && fs::exists(format(1)))
+                    next = 1;
+            }
+        }
+
+        bool read(cv::Mat &frame) override
+        {
+            std::string path;
+            if (pattern.empty())
+            {
+                if (next >= static_cast<long long>(files.size()))
+                    return false;
+                path = files[next++];
+            }
+            else
+            {
+                path = format(next++);
+                if (!fs::exists(path))
+                    return false;
+            }
+            frame = cv::imread(path, cv::IMREAD_UNCHANGED);
+            return !frame.empty();
+        }
+
+    private:
+        std::string pattern;
+        std::vector<std::string> files;
+        long long next = 0;
+
+        // Шаблон вида "img_%04d.tiff" ждёт int, поэтому номер передаётся как int
+        std::string format(long long index) const
+        {
+            std::vector<char> buffer(pattern.size() + 32);
+            const int written = std::snprintf(buffer.data(), buffer.size(), pattern.c_str(), static_cast<int>(index));
+            if (written < 0 || static_cast<size_t>(written) >= buffer.size())
+                throw std::runtime_error("Bad frame pattern: " + pattern);
+            return buffer.data();
+        }
+    };
+
+    // Сырые кадры фиксированного размера из stdin
+    class RawStdinSource : public FrameSource
+    {
+    public:
+        RawStdinSource(cv::Size size, int type) : size(size), type(type)
+        {
+            if (size.width <= 0 || size.height <= 0)
+                throw std::runtime_error("Raw stdin frames require --raw WxH");
+        }
+
+        bool read(cv::Mat &frame) override
+        {
+            frame.create(size, type);
+            const size_t bytes = frame.total() * frame.elemSize();
+            return std::fread(frame.data, 1, bytes, stdin) == bytes;
+        }
+
+    private:
+        cv::Size size;
+        int type;
+    };
+
+    std::unique_ptr<FrameSource> openSource(const StreamOptions &options)
+    {
+        if (options.source == "-")
+            return std::make_unique<RawStdinSource>(options.raw_size, options.raw_type);
+        if (fs::is_directory(options.source) || options.source.find('%') != std::string::npos)
+            return std::make_unique<SequenceSource>(options.source);
+        return std::make_unique<CaptureSource>(options.source);
+    }
+
+    struct Frame
+    {
+        long long index = 0;
+        int64_t capture_ns = 0;
+        cv::Mat image;
+    };
+
+    struct Result
+    {
+        long long index = 0;
+        int64_t capture_ns = 0;
+        json cells;
+    };
+}
+
+void LatencyHistogram::add(int64_t latency_ns)
+{
+    int64_t us = latency_ns / 1000;
+    int bucket = 0;
+    while (us > 0 && bucket < BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    counts[bucket]++;
+    total++;
+    max_ns = std::max(max_ns, latency_ns);
+}
+
+double LatencyHistogram::percentileUs(double p) const
+{
+    if (total == 0)
+        return 0.0;
+    const uint64_t rank = static_cast<uint64_t>(p * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += counts[bucket];
+        if (seen >= rank)
+            return std::min(static_cast<double>(1ULL << bucket), max_ns / 1000.0);
+    }
+    return max_ns / 1000.0;
+}
+
+json LatencyHistogram::toJson() const
+{
+    json j;
+    j["count"] = total;
+    j["p50_us"] = percentileUs(0.50);
+    j["p90_us"] = percentileUs(0.90);
+    j["p99_us"] = percentileUs(0.99);
+    j["max_us"] = max_ns / 1000.0;
+    json buckets = json::array();
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        if (counts[bucket] == 0)
+            continue;
+        buckets.push_back({{"le_us", 1ULL << bucket}, {"count", counts[bucket]}});
+    }
+    j["buckets"] = buckets;
+    return j;
+}
+
+bool parseOverflowPolicy(const std::string &name, OverflowPolicy &policy)
+{
+    if (name == "block")
+        policy = OverflowPolicy::Block;
+    else if (name == "drop")
+        policy = OverflowPolicy::Drop;
+    else if (name == "latest")
+        policy = OverflowPolicy::Latest;
+    else
+        return false;
+    return true;
+}
+
+StreamStats runFrameStream(const StreamOptions &options, std::ostream &out)
+{
+    std::unique_ptr<FrameSource> source = openSource(options);
+
+    SpscQueue<Frame> frames(options.queue_capacity);
+    SpscQueue<Result> results(options.queue_capacity);
+    std::atomic<bool> reader_done{false};
+    std::atomic<bool> compute_done{false};
+    std::atomic<long long> frames_read{0};
+    std::atomic<long long> frames_dropped{0};
+    std::atomic<long long> frames_wrong_size{0};
+    std::atomic<long long> frames_failed{0};
+
+    // Ошибка потока чтения или вычисления завершает поток кадров: остальные
+    // потоки видят failed, а текст ошибки уходит потребителю последней строкой
+    std::atomic<bool> failed{false};
+    std::string reader_error, compute_error;
+
+    const int64_t start_ns = nowNs();
+
+    std::thread reader([&]
+                       {
+        try
+        {
+            long long index = 0;
+            cv::Mat image;
+            while (!failed.load(std::memory_order_relaxed) && (options.max_frames < 0 || index < options.max_frames))
+            {
+                {
+                    TRACE_SCOPE("stream.read");
+                    if (!source->read(image))
+                        break;
+                }
+                Frame frame{index++, nowNs(), image.clone()};
+                frames_read++;
+
+                if (options.policy == OverflowPolicy::Drop)
+                {
+                    if (!frames.tryPush(std::move(frame)))
+                        frames_dropped++;
+                    continue;
+                }
+                int spins = 0;
+                while (!frames.tryPush(std::move(frame)) && !failed.load(std::memory_order_relaxed))
+                    backoff(spins);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            reader_error = std::string("Frame source failed: ") + e.what();
+            failed.store(true, std::memory_order_relaxed);
+        }
+        reader_done.store(true, std::memory_order_release); });
+
+    std::thread compute([&]
+                        {
+        try
+        {
+            LayoutCache layouts;
+            const CollageLayout fixed_layout = layoutFromMask(createCollageMask());
+            int spins = 0;
+            while (true)
+            {
+                std::optional<Frame> frame = frames.tryPop();
+                if (!frame)
+                {
+                    // Флаг проверяется до повторного чтения, чтобы не потерять последний кадр
+                    if (reader_done.load(std::memory_order_acquire))
+                    {
+                        frame = frames.tryPop();
+                        if (!frame)
+                            break;
+                    }
+                    else
+                    {
+                        backoff(spins);
+                        continue;
+                    }
+                }
+                spins = 0;
+
+                if (options.policy == OverflowPolicy::Latest)
+                {
+                    while (std::optional<Frame> newer = frames.tryPop())
+                    {
+                        frames_dropped++;
+                        frame = std::move(newer);
+                    }
+                }
+
+                // Кадр другого размера не ложится на фиксированную сетку: это не
+                // перегрузка, поэтому он считается отдельно от отброшенных
+                if (!options.auto_layout && frame->image.size() != fixed_layout.size)
+                {
+                    if (frames_wrong_size++ == 0)
+                        std::cerr << "Frame " << frame->index << " is " << frame->image.cols << "x" << frame->image.rows
+                                  << ", expected " << fixed_layout.size.width << "x" << fixed_layout.size.height
+                                  << "; such frames are skipped (use --auto-layout for other sizes)" << std::endl;
+                    continue;
+                }
+
+                cv::Mat gray = frame->image;
+                if (gray.channels() == 3)
+                    cv::cvtColor(frame->image, gray, cv::COLOR_BGR2GRAY);
+                else if (gray.channels() == 4)
+                    cv::cvtColor(frame->image, gray, cv::COLOR_BGRA2GRAY);
+
+                Result result{frame->index, frame->capture_ns, json()};
+                try
+                {
+                    TRACE_SCOPE("stream.evaluate");
+                    if (options.auto_layout)
+                        result.cells = evaluateCollage(gray, *layouts.get(gray, options.layout_key))["cells"];
+                    else
+                        result.cells = evaluateCollage(gray, fixed_layout)["cells"];
+                }
+                catch (const cv::Exception &e)
+                {
+                    std::cerr << "Frame " << frame->index << " skipped: " << e.what() << std::endl;
+                    frames_failed++;
+                    continue;
+                }
+
+                int push_spins = 0;
+                while (!results.tryPush(std::move(result)))
+                    backoff(push_spins);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            compute_error = std::string("Frame evaluation failed: ") + e.what();
+            failed.store(true, std::memory_order_relaxed);
+        }
+        compute_done.store(true, std::memory_order_release); });
+
+    StreamStats stats;
+    int spins = 0;
+    while (true)
+    {
+        std::optional<Result> result = results.tryPop();
+        if (!result)
+        {
+            if (compute_done.load(std::memory_order_acquire))
+            {
+                result = results.tryPop();
+                if (!result)
+                    break;
+            }
+            else
+            {
+                backoff(spins);
+                continue;
+            }
+        }
+        spins = 0;
+
+        const int64_t latency_ns = nowNs() - result->capture_ns;
+        json line;
+        line["frame"] = result->index;
+        line["timestamp_us"] = (result->capture_ns - start_ns) / 1000.0;
+        line["latency_us"] = latency_ns / 1000.0;
+        line["cells"] = std::move(result->cells);
+        {
+            TRACE_SCOPE("stream.write");
+            out << line.dump() << '\n';
+            out.flush();
+        }
+
+        stats.latency.add(latency_ns);
+        stats.frames_processed++;
+    }
+
+    reader.join();
+    compute.join();
+
+    stats.frames_read = frames_read.load();
+    stats.frames_dropped = frames_dropped.load();
+    stats.frames_wrong_size = frames_wrong_size.load();
+    stats.frames_failed = frames_failed.load();
+    stats.error = !reader_error.empty() ? reader_error : compute_error;
+    if (!stats.error.empty())
+    {
+        json line;
+        line["error"] = stats.error;
+        out << line.dump() << '\n';
+        out.flush();
+    }
+    return stats;
+}
@@ -0,0 +1,363 @@
+#include "sweep.h"
+#include "evaluator.h"
+#include "layout.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    fs::path pendingDir(const std::string &dir) { return fs::path(dir) / "queue" / "pending"; }
+    fs::path claimedDir(const std::string &dir) { return fs::path(dir) / "queue" / "claimed"; }
+    fs::path doneDir(const std::string &dir) { return fs::path(dir) / "queue" / "done"; }
+    fs::path resultsDir(const std::string &dir) { return fs::path(dir) / "results"; }
+
+    int countFiles(const fs::path &dir)
+    {
+        int count = 0;
+        std::error_code ec;
+        for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            if (it->path().extension() == ".json")
+                count++;
+        return count;
+    }
+
+    // Запись целиком во временный файл и rename: читатель видит либо
+    // старое содержимое, либо новое
+    void writeAtomically(const fs::path &path, const std::string &text)
+    {
+        const fs::path tmp = path.string() + ".tmp." + std::to_string(::getpid());
+        {
+            std::ofstream out(tmp);
+            out << text;
+            if (!out)
+                throw std::runtime_error("Failed to write " + tmp.string());
+        }
+        fs::rename(tmp, path);
+    }
+
+    // Отметка владельца: время изменения файла в claimed — время последнего heartbeat
+    bool touch(const fs::path &path)
+    {
+        std::error_code ec;
+        fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        return !ec;
+    }
+
+    // Захваченный файл называется <id>~<worker>.json: владелец узнаётся по имени,
+    // а переименование чужим процессом (возврат в pending) лишает его владения
+    constexpr char OWNER_SEPARATOR = '~';
+
+    std::string itemIdOf(const fs::path &path)
+    {
+        const std::string stem = path.stem().string();
+        return stem.substr(0, stem.find(OWNER_SEPARATOR));
+    }
+
+    std::string ownerSuffix(const std::string &worker_id)
+    {
+        std::string suffix = worker_id;
+        for (char &c : suffix)
+            if (c == '/' || c == OWNER_SEPARATOR)
+                c = '_';
+        return OWNER_SEPARATOR + suffix;
+    }
+
+    bool isClaimed(const std::string &sweep_dir, const std::string &id)
+    {
+        std::error_code ec;
+        for (fs::directory_iterator it(claimedDir(sweep_dir), ec), end; !ec && it != end; it.increment(ec))
+            if (it->path().extension() == ".json" && itemIdOf(it->path()) == id)
+                return true;
+        return false;
+    }
+
+    // Фоновый heartbeat: файл захвата обновляется, пока элемент в работе,
+    // даже если одна оценка длится дольше срока аренды
+    class Heartbeat
+    {
+    public:
+        Heartbeat(const fs::path &path, int lease_seconds)
+            : thread([this, path, lease_seconds]
+                     {
+                         const auto period = std::chrono::milliseconds(std::max(250, lease_seconds * 1000 / 4));
+                         std::unique_lock<std::mutex> lock(mutex);
+                         while (!wake.wait_for(lock, period, [this] { return stop; }))
+                             touch(path);
+                     })
+        {
+        }
+
+        ~Heartbeat()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wake.notify_all();
+            thread.join();
+        }
+
+        Heartbeat(const Heartbeat &) = delete;
+        Heartbeat &operator=(const Heartbeat &) = delete;
+
+    private:
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stop = false;
+        std::thread thread;
+    };
+
+    bool claimItem(const std::string &sweep_dir, const std::string &worker_id, SweepItem &item, fs::path &claim_path)
+    {
+        std::vector<fs::path> candidates;
+        std::error_code ec;
+        for (fs::directory_iterator it(pendingDir(sweep_dir), ec), end; !ec && it != end; it.increment(ec))
+            if (it->path().extension() == ".json")
+                candidates.push_back(it->path());
+        std::sort(candidates.begin(), candidates.end());
+
+        for (const fs::path &candidate : candidates)
+        {
+            // Время обновляется до переноса, иначе элемент с давним временем
+            // создания сразу выглядел бы просроченным для других процессов
+            if (!touch(candidate))
+                continue;
+            const fs::path target = claimedDir(sweep_dir) / (candidate.stem().string() + ownerSuffix(worker_id) + ".json");
+            fs::rename(candidate, target, ec);
+            if (ec)
+                continue; // элемент забрал другой процесс
+
+            std::ifstream in(target);
+            json j = json::parse(in);
+            item.distribution = j.at("distribution");
+            item.seed = j.at("seed");
+            claim_path = target;
+            return true;
+        }
+        return false;
+    }
+
+    std::string defaultWorkerId()
+    {
+        char host[256] = {};
+        ::gethostname(host, sizeof(host) - 1);
+        return std::string(host) + ":" + std::to_string(::getpid());
+    }
+}
+
+SweepManifest parseSweepManifest(const json &manifest)
+{
+    SweepManifest m;
+    m.name = manifest.value("name", "");
+    m.distributions = manifest.value("distributions", m.distributions);
+    m.snr_levels = manifest.value("snr_db", m.snr_levels);
+    m.seeds = manifest.value("seeds", m.seeds);
+    if (manifest.contains("grid"))
+    {
+        m.grid.means = manifest["grid"].value("means", m.grid.means);
+        m.grid.stddevs = manifest["grid"].value("stddevs", m.grid.stddevs);
+    }
+    if (!parseStorageFormat(manifest.value("storage", "float32"), m.storage))
+        throw std::runtime_error("Unknown storage format in manifest");
+    m.keep_images = manifest.value("keep_images", m.keep_images);
+    m.auto_layout = manifest.value("auto_layout", m.auto_layout);
+    m.approx = manifest.value("approx", m.approx);
+    m.sketch = manifest.value("sketch", m.sketch);
+    return m;
+}
+
+std::string sweepItemId(const SweepItem &item)
+{
+    return "d" + std::to_string(item.distribution) + "_s" + std::to_string(item.seed);
+}
+
+int initSweep(const std::string &manifest_path, const std::string &sweep_dir)
+{
+    std::ifstream manifest_file(manifest_path);
+    if (!manifest_file.is_open())
+        throw std::runtime_error("Error opening manifest: " + manifest_path);
+    json manifest_json = json::parse(manifest_file);
+    SweepManifest manifest = parseSweepManifest(manifest_json);
+
+    for (const fs::path &dir : {pendingDir(sweep_dir), claimedDir(sweep_dir), doneDir(sweep_dir),
+                                resultsDir(sweep_dir), fs::path(sweep_dir) / "images"})
+        fs::create_directories(dir);
+    writeAtomically(fs::path(sweep_dir) / "manifest.json", manifest_json.dump(4));
+
+    int queued = 0;
+    for (int dist : manifest.distributions)
+    {
+        for (int seed : manifest.seeds)
+        {
+            SweepItem item{dist, seed};
+            const std::string file_name = sweepItemId(item) + ".json";
+            if (fs::exists(pendingDir(sweep_dir) / file_name) || isClaimed(sweep_dir, sweepItemId(item)) ||
+                fs::exists(doneDir(sweep_dir) / file_name))
+                continue;
+
+            json j;
+            j["distribution"] = dist;
+            j["seed"] = seed;
+            writeAtomically(pendingDir(sweep_dir) / file_name, j.dump());
+            queued++;
+        }
+    }
+    return queued;
+}
+
+SweepStatus sweepStatus(const std::string &sweep_dir)
+{
+    SweepStatus status;
+    status.pending = countFiles(pendingDir(sweep_dir));
+    status.claimed = countFiles(claimedDir(sweep_dir));
+    status.done = countFiles(doneDir(sweep_dir));
+    return status;
+}
+
+int reclaimStaleItems(const std::string &sweep_dir, int lease_seconds)
+{
+    const auto deadline = fs::file_time_type::clock::now() - std::chrono::seconds(lease_seconds);
+    int reclaimed = 0;
+    std::error_code ec;
+    for (fs::directory_iterator it(claimedDir(sweep_dir), ec), end; !ec && it != end; it.increment(ec))
+    {
+        if (it->path().extension() != ".json")
+            continue;
+        std::error_code time_ec;
+        if (fs::last_write_time(it->path(), time_ec) > deadline || time_ec)
+            continue;
+        // Из нескольких процессов rename удастся только одному
+        std::error_code rename_ec;
+        fs::rename(it->path(), pendingDir(sweep_dir) / (itemIdOf(it->path()) + ".json"), rename_ec);
+        if (!rename_ec)
+            reclaimed++;
+    }
+    return reclaimed;
+}
+
+bool runSweepItem(const SweepManifest &manifest, const std::string &sweep_dir, const SweepItem &item,
+                  const std::string &claim_path)
+{
+    TRACE_SCOPE("sweep.item");
+    // randn/randu используют генератор OpenCV, экспоненциальное — rng генератора;
+    // оба засеваются зерном элемента, так что результат не зависит от процесса
+    cv::setRNGSeed(item.seed);
+    ImageGenerator generator(item.distribution, 0.0, item.seed);
+    const cv::Mat clean = generator.generateGrid(item.distribution, manifest.grid);
+
+    const CollageLayout fixed_layout = layoutFromMask(createCollageMask(static_cast<int>(manifest.grid.means.size()),
+                                                                        static_cast<int>(manifest.grid.stddevs.size())));
+    LayoutCache layouts;
+    ApproxOptions approx;
+    approx.tolerance = manifest.approx;
+    approx.seed = static_cast<uint64_t>(item.seed);
+
+    json shard = json::array();
+    for (double snr_db : manifest.snr_levels)
+    {
+        const std::string name = "d" + std::to_string(item.distribution) + "_snr" + std::to_string((int)snr_db) +
+                                 "dB_s" + std::to_string(item.seed);
+        cv::Mat noisy = generator.applyGaussianNoise(clean, snr_db);
+
+        // Оценивается то, что было бы прочитано с диска в выбранном формате
+        StorageInfo info;
+        cv::Mat stored = encodeCollage(noisy, manifest.storage, info);
+        if (manifest.keep_images)
+            writeCollage((fs::path(sweep_dir) / "images" / (name + ".tiff")).string(), noisy, manifest.storage);
+
+        const CollageLayout &layout = manifest.auto_layout ? *layouts.get(stored, manifest.name) : fixed_layout;
+
+        json entry;
+        entry["distribution"] = item.distribution;
+        entry["snr_db"] = snr_db;
+        entry["seed"] = item.seed;
+        entry["gt"] = ImageGenerator::createMetadata(item.distribution, snr_db, manifest.grid);
+        // Сводки строятся по всем пикселям, поэтому отменяют подвыборку
+        entry["evaluation"] = manifest.sketch ? evaluateCollageStatistics(stored, layout, STAT_MOMENTS, true)
+                                              : evaluateCollage(stored, layout, manifest.approx > 0.0 ? &approx : nullptr);
+        shard.push_back(std::move(entry));
+
+        touch(claim_path);
+    }
+
+    // Элемент, возвращённый в pending как просроченный, досчитает новый владелец
+    if (!fs::exists(claim_path))
+        return false;
+    writeAtomically(resultsDir(sweep_dir) / (sweepItemId(item) + ".json"), shard.dump());
+    return true;
+}
+
+int runSweepWorker(const std::string &sweep_dir, const SweepWorkerOptions &options)
+{
+    std::ifstream manifest_file(fs::path(sweep_dir) / "manifest.json");
+    if (!manifest_file.is_open())
+        throw std::runtime_error("No manifest in " + sweep_dir + " (run init first)");
+    const SweepManifest manifest = parseSweepManifest(json::parse(manifest_file));
+    const std::string worker_id = options.worker_id.empty() ? defaultWorkerId() : options.worker_id;
+
+    int processed = 0;
+    while (options.max_items < 0 || processed < options.max_items)
+    {
+        const int reclaimed = reclaimStaleItems(sweep_dir, options.lease_seconds);
+        if (reclaimed > 0)
+            std::cerr << worker_id << ": reclaimed " << reclaimed << " stale item(s)" << std::endl;
+
+        SweepItem item;
+        fs::path claim_path;
+        if (claimItem(sweep_dir, worker_id, item, claim_path))
+        {
+            std::cerr << worker_id << ": " << sweepItemId(item) << std::endl;
+            bool written;
+            {
+                Heartbeat heartbeat(claim_path, options.lease_seconds);
+                written = runSweepItem(manifest, sweep_dir, item, claim_path.string());
+            }
+
+            // Файл с нашим именем в claimed — признак владения; если элемент
+            // вернули в pending, rename не удастся и done остаётся новому владельцу
+            std::error_code ec;
+            if (written)
+                fs::rename(claim_path, doneDir(sweep_dir) / (sweepItemId(item) + ".json"), ec);
+            if (!written || ec)
+                std::cerr << worker_id << ": lost claim on " << sweepItemId(item) << std::endl;
+            else
+                processed++;
+            continue;
+        }
+
+        // Свободных элементов нет: ждём завершения или просрочки чужих
+        if (sweepStatus(sweep_dir).claimed == 0)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(options.poll_ms));
+    }
+    return processed;
+}
+
+std::vector<json> loadSweepResults(const std::string &sweep_dir)
+{
+    std::vector<fs::path> shards;
+    for (const auto &entry : fs::directory_iterator(resultsDir(sweep_dir)))
+        if (entry.path().extension() == ".json")
+            shards.push_back(entry.path());
+    std::sort(shards.begin(), shards.end());
+
+    std::vector<json> results;
+    for (const fs::path &shard_path : shards)
+    {
+        std::ifstream in(shard_path);
+        for (json &entry : json::parse(in))
+            results.push_back(std::move(entry));
+    }
+    return results;
+}
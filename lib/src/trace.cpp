@@ -0,0 +1,263 @@
+#include "trace.h"
+
+#ifdef VISION_TRACE
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace trace
+{
+    namespace
+    {
+        struct Event
+        {
+            const char *name;
+            int64_t start_ns;
+            int64_t dur_ns; // -1 для счётчиков
+            double value;
+        };
+
+        // Буфер одного потока; mutex почти всегда свободен и нужен только на время выгрузки
+        struct ThreadBuffer
+        {
+            int tid;
+            std::mutex mutex;
+            std::vector<Event> events;
+        };
+
+        // Буфер потока выгружается в файл, не дожидаясь flush, когда в нём
+        // накопилось столько событий: память долгоживущего процесса ограничена
+        constexpr size_t MAX_BUFFERED_EVENTS = 1 << 16;
+
+        struct Stat
+        {
+            int64_t count = 0;
+            int64_t total_ns = 0;
+            int64_t max_ns = 0;
+            double counter_sum = 0.0;
+            bool is_counter = false;
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+            const char *path = std::getenv("VISION_TRACE");
+            const int64_t origin_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                          std::chrono::steady_clock::now().time_since_epoch())
+                                          .count();
+
+            // Выгруженные события: файл дописывается, сводка копится по именам
+            std::ofstream out;
+            std::streampos tail;      // позиция перед закрывающими скобками
+            bool has_events = false;
+            bool open_failed = false; // без файла копится только сводка
+            std::map<std::string, Stat> stats;
+        };
+
+        Registry &registry()
+        {
+            static Registry instance;
+            return instance;
+        }
+
+        // Дописывает события в trace-файл и сводку; вызывается под reg.mutex.
+        // После каждой выгрузки файл закрыт скобками и остаётся корректным JSON
+        void drainLocked(Registry &reg, int tid, const std::vector<Event> &events)
+        {
+            if (!reg.out.is_open() && !reg.open_failed)
+            {
+                reg.out.open(reg.path, std::ios::out | std::ios::trunc);
+                if (reg.out.is_open())
+                {
+                    reg.out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+                    reg.tail = reg.out.tellp();
+                }
+                else
+                {
+                    std::cerr << "Error opening trace file: " << reg.path << std::endl;
+                    reg.open_failed = true;
+                }
+            }
+            const bool writing = reg.out.is_open();
+
+            const int pid = static_cast<int>(getpid());
+            if (writing)
+                reg.out.seekp(reg.tail);
+            for (const Event &e : events)
+            {
+                json j;
+                j["name"] = e.name;
+                j["pid"] = pid;
+                j["tid"] = tid;
+                j["ts"] = e.start_ns / 1000.0; // trace-event ожидает микросекунды
+
+                Stat &s = reg.stats[e.name];
+                s.count++;
+                if (e.dur_ns >= 0)
+                {
+                    j["ph"] = "X";
+                    j["dur"] = e.dur_ns / 1000.0;
+                    s.total_ns += e.dur_ns;
+                    s.max_ns = std::max(s.max_ns, e.dur_ns);
+                }
+                else
+                {
+                    j["ph"] = "C";
+                    j["args"]["value"] = e.value;
+                    s.is_counter = true;
+                    s.counter_sum += e.value;
+                }
+                if (!writing)
+                    continue;
+                reg.out << (reg.has_events ? ",\n" : "\n") << j.dump();
+                reg.has_events = true;
+            }
+            if (!writing)
+                return;
+            reg.tail = reg.out.tellp();
+            reg.out << "\n]}\n";
+            reg.out.flush();
+        }
+
+        // Забирает накопленные события всех потоков; вызывается под reg.mutex
+        void drainAllLocked(Registry &reg)
+        {
+            for (const auto &buffer : reg.buffers)
+            {
+                std::vector<Event> events;
+                {
+                    std::lock_guard<std::mutex> lock(buffer->mutex);
+                    events.swap(buffer->events);
+                    buffer->events.reserve(4096);
+                }
+                if (!events.empty())
+                    drainLocked(reg, buffer->tid, events);
+            }
+        }
+
+        ThreadBuffer &localBuffer()
+        {
+            // Реестр держит shared_ptr, поэтому события переживают завершение потока
+            thread_local std::shared_ptr<ThreadBuffer> buffer = []
+            {
+                auto created = std::make_shared<ThreadBuffer>();
+                created->events.reserve(4096);
+                Registry &reg = registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                created->tid = static_cast<int>(reg.buffers.size());
+                reg.buffers.push_back(created);
+                return created;
+            }();
+            return *buffer;
+        }
+
+        void push(const Event &event)
+        {
+            ThreadBuffer &buffer = localBuffer();
+            std::vector<Event> full;
+            {
+                std::lock_guard<std::mutex> lock(buffer.mutex);
+                buffer.events.push_back(event);
+                if (buffer.events.size() < MAX_BUFFERED_EVENTS)
+                    return;
+                full.swap(buffer.events);
+                buffer.events.reserve(4096);
+            }
+            // Замок буфера отпущен до захвата реестра: порядок тот же, что во flush
+            Registry &reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            drainLocked(reg, buffer.tid, full);
+        }
+    }
+
+    bool enabled()
+    {
+        static const bool on = registry().path != nullptr && registry().path[0] != '\0';
+        return on;
+    }
+
+    int64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count() -
+               registry().origin_ns;
+    }
+
+    void recordSpan(const char *name, int64_t start_ns, int64_t end_ns)
+    {
+        push({name, start_ns, end_ns - start_ns, 0.0});
+    }
+
+    void recordCounter(const char *name, double value)
+    {
+        push({name, nowNs(), -1, value});
+    }
+
+    void printSummary(std::ostream &out)
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> reg_lock(reg.mutex);
+        drainAllLocked(reg);
+        const std::map<std::string, Stat> &stats = reg.stats;
+
+        // Таблица собирается в свой поток, чтобы не менять флаги форматирования out
+        std::ostringstream table;
+        table << std::left << std::setw(28) << "stage"
+              << std::right << std::setw(10) << "count"
+              << std::setw(14) << "total ms"
+              << std::setw(14) << "mean us"
+              << std::setw(14) << "max us" << "\n";
+        table << std::fixed << std::setprecision(3);
+        bool has_counters = false;
+        for (const auto &[name, s] : stats)
+        {
+            if (s.is_counter)
+            {
+                has_counters = true;
+                continue;
+            }
+            table << std::left << std::setw(28) << name << std::right << std::setw(10) << s.count
+                  << std::setw(14) << s.total_ns / 1e6
+                  << std::setw(14) << s.total_ns / 1e3 / s.count
+                  << std::setw(14) << s.max_ns / 1e3 << "\n";
+        }
+
+        if (has_counters)
+        {
+            table << "\n"
+                  << std::left << std::setw(28) << "counter"
+                  << std::right << std::setw(10) << "count"
+                  << std::setw(14) << "sum" << "\n";
+            for (const auto &[name, s] : stats)
+            {
+                if (s.is_counter)
+                    table << std::left << std::setw(28) << name << std::right << std::setw(10) << s.count
+                          << std::setw(14) << s.counter_sum << "\n";
+            }
+        }
+        out << table.str();
+    }
+
+    void flush()
+    {
+        if (!enabled())
+            return;
+        printSummary(std::cerr);
+    }
+}
+
+#endif
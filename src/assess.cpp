@@ -4,9 +4,19 @@
 #include <map>
 #include <cmath>
 #include <iomanip>
+#include <sstream>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <filesystem>
 #include <opencv2/opencv.hpp>
+#include <trace.h>
+#include <storage.h>
+#include <sweep.h>
+#include <report.h>
+#include <sketch.h>
+#include <results.h>
+#include <tuple>
+#include <unordered_map>
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
@@ -19,6 +29,17 @@ struct ErrorMetrics
     double mean_kurtosis_error;
     std::vector<double> skewness_errors;
     std::vector<double> kurtosis_errors;
+    // Параметры ячеек из gt в том же порядке, что и ошибки (NaN, если их нет)
+    std::vector<double> cell_means;
+    std::vector<double> cell_stddevs;
+    // Доля ячеек, где теоретическое значение попало в доверительный
+    // интервал eval (--bootstrap/--jackknife); -1, если интервалов нет
+    double skewness_ci_coverage = -1.0;
+    double kurtosis_ci_coverage = -1.0;
+    // Ошибка относительно предсказания с учётом шума (predicted_* в gt);
+    // -1, если предсказаний нет
+    double mean_skewness_error_predicted = -1.0;
+    double mean_kurtosis_error_predicted = -1.0;
 };
 
 struct CollageErrorMetrics
@@ -29,6 +50,19 @@ struct CollageErrorMetrics
     double mean_kurtosis_error;
     std::vector<double> skewness_errors;
     std::vector<double> kurtosis_errors;
+    std::vector<double> cell_means;
+    std::vector<double> cell_stddevs;
+    double skewness_ci_coverage;
+    double kurtosis_ci_coverage;
+    double mean_skewness_error_predicted;
+    double mean_kurtosis_error_predicted;
+    // Формат хранения изображения и внесённая им ошибка моментов
+    // относительно float32; пустой формат и -1 для обычного float32
+    std::string storage_format;
+    double storage_max_skewness_error = -1.0;
+    double storage_max_kurtosis_error = -1.0;
+    // Число повторов (зёрен), усреднённых в записи; 1 для обычного прогона
+    int replicates = 1;
 };
 
 struct DistributionMetrics
@@ -47,34 +81,20 @@ double relativeError(double groundTruth, double evaluated)
     return fabs((evaluated - groundTruth) / groundTruth);
 };
 
-ErrorMetrics compareJsonFiles(const std::string &gt_path, const std::string &eval_path)
+// Накопление ошибок по парам ячеек (gt, eval); общее для разбора DOM и SAX
+class ErrorAccumulator
 {
-    // Загрузка файлов
-    std::ifstream gt_file(gt_path);
-    std::ifstream eval_file(eval_path);
-    json gt_data = json::parse(gt_file);
-    json eval_data = json::parse(eval_file);
-
-    ErrorMetrics metrics;
-    double total_skew_error = 0.0;
-    double total_kurt_error = 0.0;
-    int cell_count = 0;
-
-    // Проход по всем ячейкам
-    for (const auto &eval_cell : eval_data["cells"])
+public:
+    void add(const CellRecord &gt_cell, const CellRecord &eval_cell)
     {
-        int row = eval_cell["row"];
-        int col = eval_cell["column"];
+        // Многоканальные оценки (массивы) не сравниваются
+        if (std::isnan(eval_cell.evaluated_skewness) || std::isnan(eval_cell.evaluated_kurtosis))
+            return;
 
-        // Поиск соответствующей ячейки в ground truth
-        const auto &gt_row = gt_data["cells"][row];
-        const auto &gt_cell = gt_row[col];
-
-        // Получение значений
-        double gt_skew = gt_cell["theoretical_skewness"];
-        double gt_kurt = gt_cell["theoretical_kurtosis"];
-        double eval_skew = eval_cell["evaluated_skewness"];
-        double eval_kurt = eval_cell["evaluated_kurtosis"];
+        const double gt_skew = gt_cell.theoretical_skewness;
+        const double gt_kurt = gt_cell.theoretical_kurtosis;
+        const double eval_skew = eval_cell.evaluated_skewness;
+        const double eval_kurt = eval_cell.evaluated_kurtosis;
 
         // Расчет ошибок
         double skew_error = relativeError(gt_skew, eval_skew);
@@ -83,17 +103,134 @@ ErrorMetrics compareJsonFiles(const std::string &gt_path, const std::string &eva
         // Сохранение ошибок
         metrics.skewness_errors.push_back(skew_error);
         metrics.kurtosis_errors.push_back(kurt_error);
+        metrics.cell_means.push_back(gt_cell.mean);
+        metrics.cell_stddevs.push_back(gt_cell.stddev);
 
         total_skew_error += skew_error;
         total_kurt_error += kurt_error;
         cell_count++;
+
+        // Сравнение с ожидаемыми значениями для данного SNR: остаток — ошибка
+        // метода оценки, а не влияние шума
+        if (!std::isnan(gt_cell.predicted_skewness) && !std::isnan(gt_cell.predicted_kurtosis))
+        {
+            total_skew_error_predicted += relativeError(gt_cell.predicted_skewness, eval_skew);
+            total_kurt_error_predicted += relativeError(gt_cell.predicted_kurtosis, eval_kurt);
+            predicted_count++;
+        }
+
+        // Попадание теории в интервал отличает ошибку метода от шума выборки
+        if (!std::isnan(eval_cell.skewness_ci[1]) && !std::isnan(eval_cell.kurtosis_ci[1]))
+        {
+            if (gt_skew >= eval_cell.skewness_ci[0] && gt_skew <= eval_cell.skewness_ci[1])
+                skew_covered++;
+            if (gt_kurt >= eval_cell.kurtosis_ci[0] && gt_kurt <= eval_cell.kurtosis_ci[1])
+                kurt_covered++;
+            ci_count++;
+        }
+    }
+
+    ErrorMetrics finish()
+    {
+        if (predicted_count > 0)
+        {
+            metrics.mean_skewness_error_predicted = total_skew_error_predicted / predicted_count;
+            metrics.mean_kurtosis_error_predicted = total_kurt_error_predicted / predicted_count;
+        }
+
+        if (ci_count > 0)
+        {
+            metrics.skewness_ci_coverage = static_cast<double>(skew_covered) / ci_count;
+            metrics.kurtosis_ci_coverage = static_cast<double>(kurt_covered) / ci_count;
+        }
+
+        // Расчет средних ошибок
+        metrics.mean_skewness_error = total_skew_error / cell_count;
+        metrics.mean_kurtosis_error = total_kurt_error / cell_count;
+
+        return std::move(metrics);
     }
 
-    // Расчет средних ошибок
-    metrics.mean_skewness_error = total_skew_error / cell_count;
-    metrics.mean_kurtosis_error = total_kurt_error / cell_count;
+private:
+    ErrorMetrics metrics;
+    double total_skew_error = 0.0;
+    double total_kurt_error = 0.0;
+    int cell_count = 0;
+    int ci_count = 0;
+    int skew_covered = 0;
+    int kurt_covered = 0;
+    int predicted_count = 0;
+    double total_skew_error_predicted = 0.0;
+    double total_kurt_error_predicted = 0.0;
+};
+
+static long long cellKey(int row, int col)
+{
+    return (static_cast<long long>(row) << 32) | static_cast<unsigned>(col);
+}
 
-    return metrics;
+// Ячейки gt по (row, column): вложенный массив cells[row][col] (gen)
+// или плоский список с полями row и column (NDJSON)
+std::unordered_map<long long, CellRecord> indexGtCells(const json &gt_data)
+{
+    std::unordered_map<long long, CellRecord> cells;
+    const json &rows = gt_data["cells"];
+    for (size_t row = 0; row < rows.size(); row++)
+    {
+        if (!rows[row].is_array())
+        {
+            CellRecord cell = cellRecordFromJson(rows[row]);
+            cells[cellKey(cell.row, cell.column)] = cell;
+            continue;
+        }
+        for (size_t col = 0; col < rows[row].size(); col++)
+            cells[cellKey(row, col)] = cellRecordFromJson(rows[row][col], row, col);
+    }
+    return cells;
+}
+
+ErrorMetrics compareJson(const json &gt_data, const json &eval_data)
+{
+    const std::unordered_map<long long, CellRecord> gt_cells = indexGtCells(gt_data);
+    ErrorAccumulator accumulator;
+
+    // Проход по всем ячейкам
+    for (const auto &eval_cell : eval_data["cells"])
+    {
+        // Поиск соответствующей ячейки в ground truth
+        const CellRecord eval_record = cellRecordFromJson(eval_cell);
+        auto it = gt_cells.find(cellKey(eval_record.row, eval_record.column));
+        if (it != gt_cells.end())
+            accumulator.add(it->second, eval_record);
+    }
+    return accumulator.finish();
+}
+
+// Файлы читаются потоково (SAX): в памяти держатся только поля ячеек gt,
+// ячейки eval сравниваются по мере разбора. Понимает JSON и NDJSON
+ErrorMetrics compareJsonFiles(const std::string &gt_path, const std::string &eval_path)
+{
+    std::unordered_map<long long, CellRecord> gt_cells;
+    ErrorAccumulator accumulator;
+    {
+        TRACE_SCOPE("json.parse");
+        if (!readCellRecords(gt_path, [&](const CellRecord &cell)
+                             { gt_cells[cellKey(cell.row, cell.column)] = cell; }))
+            std::cerr << "Warning: failed to parse " << gt_path << std::endl;
+
+        if (!readCellRecords(eval_path, [&](const CellRecord &cell)
+                             {
+                                 auto it = gt_cells.find(cellKey(cell.row, cell.column));
+                                 if (it != gt_cells.end())
+                                     accumulator.add(it->second, cell); }))
+            std::cerr << "Warning: failed to parse " << eval_path << std::endl;
+    }
+    return accumulator.finish();
+}
+
+static std::string resultPath(const std::string &base)
+{
+    return fs::exists(base + ".json") || !fs::exists(base + ".ndjson") ? base + ".json" : base + ".ndjson";
 }
 
 std::vector<CollageErrorMetrics> collectAllErrorMetrics(
@@ -107,11 +244,11 @@ std::vector<CollageErrorMetrics> collectAllErrorMetrics(
     {
         for (double snr_db : snr_levels)
         {
-            // Формирование путей к файлам
-            std::string gt_filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB.json";
-            std::string gt_path = "../src/gt/" + gt_filename;
-            std::string eval_filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB_eval.json";
-            std::string eval_path = "../src/evaluations/" + eval_filename;
+            // Формирование путей к файлам; при отсутствии .json берётся .ndjson (--ndjson)
+            std::string gt_filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB";
+            std::string gt_path = resultPath("../src/gt/" + gt_filename);
+            std::string eval_filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB_eval";
+            std::string eval_path = resultPath("../src/evaluations/" + eval_filename);
 
             // Проверка существования файлов
             if (!fs::exists(gt_path))
@@ -136,6 +273,26 @@ std::vector<CollageErrorMetrics> collectAllErrorMetrics(
             collage_metrics.mean_kurtosis_error = metrics.mean_kurtosis_error;
             collage_metrics.skewness_errors = std::move(metrics.skewness_errors);
             collage_metrics.kurtosis_errors = std::move(metrics.kurtosis_errors);
+            collage_metrics.cell_means = std::move(metrics.cell_means);
+            collage_metrics.cell_stddevs = std::move(metrics.cell_stddevs);
+            collage_metrics.skewness_ci_coverage = metrics.skewness_ci_coverage;
+            collage_metrics.kurtosis_ci_coverage = metrics.kurtosis_ci_coverage;
+            collage_metrics.mean_skewness_error_predicted = metrics.mean_skewness_error_predicted;
+            collage_metrics.mean_kurtosis_error_predicted = metrics.mean_kurtosis_error_predicted;
+
+            // Метаданные компактного хранения пишет gen рядом с изображением
+            std::string image_path = "../src/test_images/d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB.tiff";
+            std::ifstream sidecar_file(storageSidecarPath(image_path));
+            if (sidecar_file.is_open())
+            {
+                json sidecar = json::parse(sidecar_file);
+                collage_metrics.storage_format = sidecar.value("format", "");
+                if (sidecar.contains("moment_error"))
+                {
+                    collage_metrics.storage_max_skewness_error = sidecar["moment_error"]["max_skewness_error"];
+                    collage_metrics.storage_max_kurtosis_error = sidecar["moment_error"]["max_kurtosis_error"];
+                }
+            }
 
             all_metrics.push_back(std::move(collage_metrics));
         }
@@ -144,209 +301,362 @@ std::vector<CollageErrorMetrics> collectAllErrorMetrics(
     return all_metrics;
 };
 
-void plotErrorMetrics(const std::map<int, DistributionMetrics> &metrics_map)
+// Объединение записей shard'ов прогона sweep (loadSweepResults): ошибки
+// усредняются по зёрнам для каждой пары (распределение, SNR)
+std::vector<CollageErrorMetrics> mergeSweepResults(const std::vector<json> &entries, const std::string &sweep_dir)
 {
-    // Определение цветов для каждого распределения
-    const std::map<int, cv::Scalar> distribution_colors = {
-        {0, cv::Scalar(0, 0, 255)},   // Красный
-        {1, cv::Scalar(0, 165, 255)}, // Оранжевый
-        {2, cv::Scalar(0, 255, 0)}    // Зеленый
-    };
-
-    // Параметры графика
-    const int WIDTH = 1200;
-    const int HEIGHT = 800;
-    const int MARGIN = 100;
-    const int GRAPH_HEIGHT = HEIGHT - 2 * MARGIN;
-    const int GRAPH_WIDTH = WIDTH - 2 * MARGIN;
-
-    // Создание изображения для графика
-    cv::Mat plot_image(HEIGHT, WIDTH, CV_8UC3, cv::Scalar(255, 255, 255));
-
-    // Находим максимальные значения для масштабирования
-    double max_snr = 50.0;
-    double max_error = 0.0;
+    std::map<std::pair<int, double>, std::vector<ErrorMetrics>> groups;
+    for (const json &entry : entries)
+    {
+        TRACE_SCOPE("ass.compare");
+        groups[{entry["distribution"].get<int>(), entry["snr_db"].get<double>()}].push_back(
+            compareJson(entry["gt"], entry["evaluation"]));
+    }
 
-    for (const auto &[dist, metrics] : metrics_map)
+    // Среднее по повторам; поля со значением -1 (нет данных) не учитываются
+    auto average = [](const std::vector<ErrorMetrics> &replicates, double ErrorMetrics::*field)
     {
-        for (double err : metrics.skewness_errors)
+        double sum = 0.0;
+        int count = 0;
+        for (const ErrorMetrics &m : replicates)
         {
-            if (err > max_error)
-                max_error = err;
+            if (m.*field < 0.0)
+                continue;
+            sum += m.*field;
+            count++;
         }
-        for (double err : metrics.kurtosis_errors)
+        return count > 0 ? sum / count : -1.0;
+    };
+
+    std::vector<CollageErrorMetrics> all_metrics;
+    for (auto &[key, replicates] : groups)
+    {
+        CollageErrorMetrics collage_metrics;
+        collage_metrics.distribution = key.first;
+        collage_metrics.snr_db = key.second;
+        collage_metrics.mean_skewness_error = average(replicates, &ErrorMetrics::mean_skewness_error);
+        collage_metrics.mean_kurtosis_error = average(replicates, &ErrorMetrics::mean_kurtosis_error);
+        collage_metrics.skewness_ci_coverage = average(replicates, &ErrorMetrics::skewness_ci_coverage);
+        collage_metrics.kurtosis_ci_coverage = average(replicates, &ErrorMetrics::kurtosis_ci_coverage);
+        collage_metrics.mean_skewness_error_predicted = average(replicates, &ErrorMetrics::mean_skewness_error_predicted);
+        collage_metrics.mean_kurtosis_error_predicted = average(replicates, &ErrorMetrics::mean_kurtosis_error_predicted);
+        for (ErrorMetrics &m : replicates)
         {
-            if (err > max_error)
-                max_error = err;
+            collage_metrics.skewness_errors.insert(collage_metrics.skewness_errors.end(), m.skewness_errors.begin(), m.skewness_errors.end());
+            collage_metrics.kurtosis_errors.insert(collage_metrics.kurtosis_errors.end(), m.kurtosis_errors.begin(), m.kurtosis_errors.end());
+            collage_metrics.cell_means.insert(collage_metrics.cell_means.end(), m.cell_means.begin(), m.cell_means.end());
+            collage_metrics.cell_stddevs.insert(collage_metrics.cell_stddevs.end(), m.cell_stddevs.begin(), m.cell_stddevs.end());
         }
+        collage_metrics.replicates = static_cast<int>(replicates.size());
+        all_metrics.push_back(std::move(collage_metrics));
     }
 
-    // Добавляем запас 10% сверху
-    max_error *= 1.1;
+    std::cout << "Merged " << all_metrics.size() << " collage groups from " << sweep_dir << std::endl;
+    return all_metrics;
+}
 
-    // Функция преобразования значений в координаты
-    auto toPlotCoords = [&](double snr, double error) -> cv::Point
+// Записи обычного прогона в том же виде, что и shard'ы sweep:
+// {distribution, snr_db, seed, gt, evaluation}; seed всегда 0
+std::vector<json> loadEvaluationEntries(const std::vector<int> &distributions,
+                                        const std::vector<double> &snr_levels)
+{
+    std::vector<json> entries;
+    for (const auto &dist : distributions)
     {
-        int x = MARGIN + static_cast<int>((snr / max_snr) * GRAPH_WIDTH);
-        int y = HEIGHT - MARGIN - static_cast<int>((error / max_error) * GRAPH_HEIGHT);
-        return cv::Point(x, y);
-    };
-
-    // Отрисовка осей
-    cv::line(plot_image,
-             cv::Point(MARGIN, HEIGHT - MARGIN),
-             cv::Point(WIDTH - MARGIN, HEIGHT - MARGIN),
-             cv::Scalar(0, 0, 0), 2);
-
-    cv::line(plot_image,
-             cv::Point(MARGIN, HEIGHT - MARGIN),
-             cv::Point(MARGIN, MARGIN),
-             cv::Scalar(0, 0, 0), 2);
-
-    // Подписи осей
-    cv::putText(plot_image, "SNR (dB)",
-                cv::Point(WIDTH / 2 - 50, HEIGHT - 20),
-                cv::FONT_HERSHEY_SIMPLEX, 0.7, cv::Scalar(0, 0, 0), 2);
-
+        for (double snr_db : snr_levels)
+        {
+            std::string name = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB";
+            std::string gt_path = resultPath("../src/gt/" + name);
+            std::string eval_path = resultPath("../src/evaluations/" + name + "_eval");
+            if (!fs::exists(gt_path) || !fs::exists(eval_path))
+                continue;
 
-    // Разметка оси X (SNR)
-    for (int snr = 0; snr <= 50; snr += 10)
-    {
-        int x = MARGIN + static_cast<int>(static_cast<double>(snr) / max_snr) * GRAPH_WIDTH;
-        cv::line(plot_image, cv::Point(x, HEIGHT - MARGIN - 5),
-                 cv::Point(x, HEIGHT - MARGIN + 5), cv::Scalar(0, 0, 0), 2);
-        cv::putText(plot_image, std::to_string(snr),
-                    cv::Point(x - 10, HEIGHT - MARGIN + 30),
-                    cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 0), 2);
+            json entry;
+            entry["distribution"] = dist;
+            entry["snr_db"] = snr_db;
+            entry["seed"] = 0;
+            TRACE_SCOPE("json.parse");
+            entry["gt"] = readResultDocument(gt_path);
+            entry["evaluation"] = readResultDocument(eval_path);
+            entries.push_back(std::move(entry));
+        }
     }
+    return entries;
+}
 
-    // Разметка оси Y (Error)
-    for (double error = 0.0; error <= max_error; error += 0.1)
+// Объединение сводок ячеек (eval --sketch, "sketch" в манифесте sweep).
+// Записи группируются по распределению, SNR и зерну; измерения из pool
+// ("seed", "snr") не входят в ключ, и их записи сливаются в одну выборку.
+// Возвращает массив групп с объединёнными статистиками и теорией из gt
+json poolSketches(const std::vector<json> &entries, bool pool_seeds, bool pool_snr)
+{
+    std::map<std::tuple<int, double, int>, SketchPool> pools;
+    std::map<std::tuple<int, double, int>, const json *> gts;
+    for (const json &entry : entries)
     {
-        int y = HEIGHT - MARGIN - static_cast<int>((error / max_error) * GRAPH_HEIGHT);
-        cv::line(plot_image, cv::Point(MARGIN - 5, y),
-                 cv::Point(MARGIN + 5, y), cv::Scalar(0, 0, 0), 1);
-
-        std::string label = std::to_string(static_cast<int>(error * 100)) + "%";
-        cv::putText(plot_image, label,
-                    cv::Point(MARGIN - 90, y + 5),
-                    cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 0), 2);
+        const std::tuple<int, double, int> key{entry["distribution"].get<int>(),
+                                               pool_snr ? -1.0 : entry["snr_db"].get<double>(),
+                                               pool_seeds ? -1 : entry.value("seed", 0)};
+        if (pools[key].add(entry["evaluation"]) > 0 && !gts.count(key))
+            gts[key] = &entry["gt"];
     }
 
-    // Отрисовка графиков для каждого распределения
-    for (const auto &[dist, metrics] : metrics_map)
+    json groups = json::array();
+    for (const auto &[key, pool] : pools)
     {
-        if (dist != 2) continue;
-        cv::Scalar color = distribution_colors.at(dist);
-        std::vector<cv::Point> skew_points, kurt_points;
-
-        // Собираем точки для графиков
-        for (size_t i = 0; i < metrics.snr_levels.size(); ++i)
+        if (pool.evaluations == 0)
+            continue;
+        json group = pool.toJson();
+        group["distribution"] = std::get<0>(key);
+        if (!pool_snr)
+            group["snr_db"] = std::get<1>(key);
+        if (!pool_seeds)
+            group["seed"] = std::get<2>(key);
+
+        // Теория не зависит от шума; предсказание — только при одном SNR
+        const std::unordered_map<long long, CellRecord> gt_cells = indexGtCells(*gts.at(key));
+        for (json &cell : group["cells"])
         {
-            skew_points.push_back(toPlotCoords(metrics.snr_levels[i], metrics.skewness_errors[i]));
-            kurt_points.push_back(toPlotCoords(metrics.snr_levels[i], metrics.kurtosis_errors[i]));
+            auto it = gt_cells.find(cellKey(cell["row"].get<int>(), cell["column"].get<int>()));
+            if (it == gt_cells.end())
+                continue;
+            const CellRecord &gt_cell = it->second;
+            if (!std::isnan(gt_cell.theoretical_skewness))
+            {
+                cell["theoretical_skewness"] = gt_cell.theoretical_skewness;
+                cell["theoretical_kurtosis"] = gt_cell.theoretical_kurtosis;
+            }
+            if (!pool_snr && !std::isnan(gt_cell.predicted_skewness))
+            {
+                cell["predicted_skewness"] = gt_cell.predicted_skewness;
+                cell["predicted_kurtosis"] = gt_cell.predicted_kurtosis;
+            }
         }
+        groups.push_back(std::move(group));
+    }
+    return groups;
+}
 
-        // Рисуем линии
-        for (size_t i = 0; i < skew_points.size() - 1; ++i)
-        {
-            cv::line(plot_image, skew_points[i], skew_points[i + 1],
-                     color, 2, cv::LINE_AA);
-            cv::line(plot_image, kurt_points[i], kurt_points[i + 1],
-                     cv::Scalar(255, 0, 0), 2, cv::LINE_AA);
-        }
+void printPooledSketches(const json &groups)
+{
+    if (groups.empty())
+    {
+        std::cout << "\nNo cell sketches found (run eval with --sketch or set \"sketch\" in the sweep manifest)" << std::endl;
+        return;
+    }
 
-        // Рисуем точки
-        for (const auto &pt : skew_points)
-        {
-            cv::circle(plot_image, pt, 5, color, -1);
-        }
-        for (const auto &pt : kurt_points)
+    std::cout << "\n===== Объединённые сводки ячеек =====";
+    for (const json &group : groups)
+    {
+        double skew_error = 0.0, kurt_error = 0.0;
+        int count = 0;
+        for (const json &cell : group["cells"])
         {
-            cv::circle(plot_image, pt, 5, cv::Scalar(255, 0, 0), -1);
+            // Многоканальные сводки в среднюю ошибку не входят
+            if (!cell["pooled_skewness"].is_number() || !cell.contains("theoretical_skewness"))
+                continue;
+            skew_error += relativeError(cell["theoretical_skewness"], cell["pooled_skewness"]);
+            kurt_error += relativeError(cell["theoretical_kurtosis"], cell["pooled_kurtosis"]);
+            count++;
         }
+
+        std::cout << "\nd" << group["distribution"].get<int>();
+        if (group.contains("snr_db"))
+            std::cout << " SNR " << group["snr_db"].get<double>() << "dB";
+        if (group.contains("seed"))
+            std::cout << " seed " << group["seed"].get<int>();
+        std::cout << " (" << group["evaluations"].get<int>() << " evaluations)";
+        if (count > 0)
+            std::cout << ": " << skew_error / count * 100 << "% (skew), " << kurt_error / count * 100 << "% (kurt)";
     }
+    std::cout << std::endl;
+}
 
-    // Легенда
-    cv::rectangle(plot_image, cv::Rect(WIDTH - 300, 50, 250, 150), cv::Scalar(200, 200, 200), -1);
-    cv::rectangle(plot_image, cv::Rect(WIDTH - 300, 50, 250, 150), cv::Scalar(0, 0, 0), 2);
+static std::string distributionName(int dist)
+{
+    if (dist == 0)
+        return "normal";
+    if (dist == 1)
+        return "uniform";
+    if (dist == 2)
+        return "exp";
+    return "d" + std::to_string(dist);
+}
 
-    int y_pos = 90;
-    for (const auto &[dist, color] : distribution_colors)
+// Сводный график: ошибки асимметрии и эксцесса всех распределений от SNR
+ReportPlot overviewPlot(const std::map<int, DistributionMetrics> &metrics_map)
+{
+    ReportPlot plot{"error_vs_snr", "Error vs SNR", "Dependence of Error on SNR", "SNR (dB)", "Error, %", {}};
+    size_t color = 0;
+    for (const auto &[dist, metrics] : metrics_map)
     {
-        if (dist != 2) continue;
-        std::string text;
-        if (dist == 0)
-            text = "normal skewness";
-        if (dist == 1)
-            text = "uniform skewness";
-        if (dist == 2)
-            text = "exp skewness";
-        cv::line(plot_image, cv::Point(WIDTH - 280, y_pos),
-                 cv::Point(WIDTH - 240, y_pos), color, 2);
-        cv::putText(plot_image, text,
-                    cv::Point(WIDTH - 220, y_pos + 5),
-                    cv::FONT_HERSHEY_SIMPLEX, 0.6, color, 2);
-        y_pos += 30;
+        ReportSeries skew{distributionName(dist) + " skewness", seriesColor(color++), metrics.snr_levels, {}};
+        ReportSeries kurt{distributionName(dist) + " kurtosis", seriesColor(color++), metrics.snr_levels, {}};
+        for (size_t i = 0; i < metrics.snr_levels.size(); ++i)
+        {
+            skew.y.push_back(metrics.skewness_errors[i] * 100);
+            kurt.y.push_back(metrics.kurtosis_errors[i] * 100);
+        }
+        plot.series.push_back(std::move(skew));
+        plot.series.push_back(std::move(kurt));
     }
+    return plot;
+}
 
-    cv::line(plot_image, cv::Point(WIDTH - 280, y_pos),
-             cv::Point(WIDTH - 240, y_pos), cv::Scalar(255, 0, 0), 2);
-    cv::putText(plot_image, "kurtosis (all)",
-                cv::Point(WIDTH - 220, y_pos + 5),
-                cv::FONT_HERSHEY_SIMPLEX, 0.6, cv::Scalar(0, 0, 0), 2);
-
-    // Заголовок
-    cv::putText(plot_image, "Dependence of Error on SNR",
-                cv::Point(WIDTH / 2 - 200, 40),
-                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 0), 2);
+void plotErrorMetrics(const std::map<int, DistributionMetrics> &metrics_map, bool show)
+{
+    cv::Mat plot_image = renderPlot(overviewPlot(metrics_map), 1200, 800);
 
     // Сохраняем результат
-    cv::imwrite("../src/assessment/error_vs_snr_plot.png", plot_image);
-    cv::imshow("Error vs SNR", plot_image);
-    cv::waitKey(0);
+    {
+        TRACE_SCOPE("io.imwrite");
+        cv::imwrite("../src/assessment/error_vs_snr_plot.png", plot_image);
+    }
+    // Окно только по явному --show: без него ass не блокируется
+    if (show)
+    {
+        cv::imshow("Error vs SNR", plot_image);
+        cv::waitKey(0);
+    }
 }
 
-void analyzeErrorMetrics(const std::vector<CollageErrorMetrics> &all_metrics)
+// Графики отчёта: по распределению (ошибка от SNR) и по параметрам ячеек
+// (для каждого среднего — ошибка от SNR, серия на каждое СКО)
+std::vector<ReportPlot> buildReportPlots(const std::vector<CollageErrorMetrics> &all_metrics)
 {
-    // Группируем метрики по типам распределений
-    std::map<int, DistributionMetrics> metrics_map;
-    std::vector<double> snr_levels = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
+    std::map<int, std::vector<const CollageErrorMetrics *>> by_distribution;
+    for (const auto &m : all_metrics)
+        by_distribution[m.distribution].push_back(&m);
 
-    for (const int dist : {0, 1, 2})
+    std::vector<ReportPlot> plots;
+    for (auto &[dist, entries] : by_distribution)
     {
-        metrics_map[dist] = DistributionMetrics{
-            snr_levels,
-            std::vector<double>(snr_levels.size(), 0.0),
-            std::vector<double>(snr_levels.size(), 0.0)};
+        std::sort(entries.begin(), entries.end(), [](const CollageErrorMetrics *a, const CollageErrorMetrics *b)
+                  { return a->snr_db < b->snr_db; });
+        const std::string name = distributionName(dist);
+        const std::string prefix = "d" + std::to_string(dist);
+
+        ReportPlot summary{prefix + "_error_vs_snr", "Distribution: " + name, name + ": error vs SNR", "SNR (dB)", "Error, %", {}};
+        std::vector<ReportSeries> series = {
+            {"skewness", seriesColor(0), {}, {}},
+            {"kurtosis", seriesColor(3), {}, {}},
+            {"skewness vs predicted", seriesColor(1), {}, {}},
+            {"kurtosis vs predicted", seriesColor(4), {}, {}}};
+        for (const CollageErrorMetrics *m : entries)
+        {
+            const double values[] = {m->mean_skewness_error, m->mean_kurtosis_error,
+                                     m->mean_skewness_error_predicted, m->mean_kurtosis_error_predicted};
+            for (size_t k = 0; k < series.size(); k++)
+            {
+                series[k].x.push_back(m->snr_db);
+                series[k].y.push_back(values[k] >= 0.0 ? values[k] * 100 : NAN);
+            }
+        }
+        for (ReportSeries &s : series)
+            if (std::any_of(s.y.begin(), s.y.end(), [](double v)
+                            { return std::isfinite(v); }))
+                summary.series.push_back(std::move(s));
+        plots.push_back(std::move(summary));
+
+        // (среднее, СКО) -> SNR -> сумма и число ошибок; повторы sweep усредняются
+        using Accumulator = std::map<double, std::pair<double, int>>;
+        std::map<std::pair<double, double>, std::pair<Accumulator, Accumulator>> cells;
+        for (const CollageErrorMetrics *m : entries)
+        {
+            for (size_t c = 0; c < m->skewness_errors.size() && c < m->cell_means.size(); c++)
+            {
+                if (!std::isfinite(m->cell_means[c]) || !std::isfinite(m->cell_stddevs[c]))
+                    continue;
+                auto &[skew, kurt] = cells[{m->cell_means[c], m->cell_stddevs[c]}];
+                skew[m->snr_db].first += m->skewness_errors[c] * 100;
+                skew[m->snr_db].second++;
+                kurt[m->snr_db].first += m->kurtosis_errors[c] * 100;
+                kurt[m->snr_db].second++;
+            }
+        }
+
+        std::map<double, std::pair<ReportPlot, ReportPlot>> by_mean;
+        for (const auto &[params, accumulators] : cells)
+        {
+            const auto [mean, stddev] = params;
+            auto found = by_mean.find(mean);
+            if (found == by_mean.end())
+            {
+                std::ostringstream label;
+                label << mean;
+                const std::string section = "Distribution: " + name + ", per cell";
+                ReportPlot skew_plot{prefix + "_mean" + label.str() + "_skewness", section,
+                                     name + ", mean " + label.str() + ": skewness error", "SNR (dB)", "Error, %", {}};
+                ReportPlot kurt_plot{prefix + "_mean" + label.str() + "_kurtosis", section,
+                                     name + ", mean " + label.str() + ": kurtosis error", "SNR (dB)", "Error, %", {}};
+                found = by_mean.emplace(mean, std::make_pair(std::move(skew_plot), std::move(kurt_plot))).first;
+            }
+
+            std::ostringstream label;
+            label << "std " << stddev;
+            auto &[skew_plot, kurt_plot] = found->second;
+            ReportSeries skew{label.str(), seriesColor(skew_plot.series.size()), {}, {}};
+            ReportSeries kurt{label.str(), seriesColor(kurt_plot.series.size()), {}, {}};
+            for (const auto &[snr, sum] : accumulators.first)
+            {
+                skew.x.push_back(snr);
+                skew.y.push_back(sum.first / sum.second);
+            }
+            for (const auto &[snr, sum] : accumulators.second)
+            {
+                kurt.x.push_back(snr);
+                kurt.y.push_back(sum.first / sum.second);
+            }
+            skew_plot.series.push_back(std::move(skew));
+            kurt_plot.series.push_back(std::move(kurt));
+        }
+        for (auto &[mean, pair] : by_mean)
+        {
+            plots.push_back(std::move(pair.first));
+            plots.push_back(std::move(pair.second));
+        }
     }
+    return plots;
+}
 
+void analyzeErrorMetrics(const std::vector<CollageErrorMetrics> &all_metrics, bool show)
+{
+    // Группируем метрики по типам распределений: распределения и уровни SNR
+    // берутся из загруженных данных, уровни упорядочены по возрастанию
+    std::map<int, std::map<double, const CollageErrorMetrics *>> by_snr;
     for (const auto &metrics : all_metrics)
-    {
-        auto it = std::find(snr_levels.begin(), snr_levels.end(), metrics.snr_db);
-        if (it == snr_levels.end())
-            continue;
-        int idx = std::distance(snr_levels.begin(), it);
+        by_snr[metrics.distribution][metrics.snr_db] = &metrics;
 
-        metrics_map[metrics.distribution].skewness_errors[idx] = metrics.mean_skewness_error;
-        metrics_map[metrics.distribution].kurtosis_errors[idx] = metrics.mean_kurtosis_error;
+    std::map<int, DistributionMetrics> metrics_map;
+    for (const auto &[dist, levels] : by_snr)
+    {
+        DistributionMetrics &dm = metrics_map[dist];
+        for (const auto &[snr_db, metrics] : levels)
+        {
+            dm.snr_levels.push_back(snr_db);
+            dm.skewness_errors.push_back(metrics->mean_skewness_error);
+            dm.kurtosis_errors.push_back(metrics->mean_kurtosis_error);
+        }
     }
 
     // Строим график
-    plotErrorMetrics(metrics_map);
+    plotErrorMetrics(metrics_map, show);
 
-    // Дополнительный анализ
+    // Дополнительный анализ: три нижних и три верхних уровня SNR (или сколько есть)
     std::cout << "\n===== Анализ зависимости ошибок от SNR =====";
     for (const auto &[dist, metrics] : metrics_map)
     {
+        const std::vector<double> &snr_levels = metrics.snr_levels;
+        const size_t n = snr_levels.size();
+        const size_t edge = std::min<size_t>(3, n);
         std::cout << "\n\n--- " << dist << " ---";
-        std::cout << "\nСредняя ошибка при низком SNR (0-10dB): "
-                  << (*std::max_element(metrics.skewness_errors.begin(), metrics.skewness_errors.begin() + 3)) * 100 << "% (skew), "
-                  << (*std::max_element(metrics.kurtosis_errors.begin(), metrics.kurtosis_errors.begin() + 3)) * 100 << "% (kurt)";
+        std::cout << "\nСредняя ошибка при низком SNR (" << snr_levels.front() << "-" << snr_levels[edge - 1] << "dB): "
+                  << (*std::max_element(metrics.skewness_errors.begin(), metrics.skewness_errors.begin() + edge)) * 100 << "% (skew), "
+                  << (*std::max_element(metrics.kurtosis_errors.begin(), metrics.kurtosis_errors.begin() + edge)) * 100 << "% (kurt)";
 
-        std::cout << "\nСредняя ошибка при высоком SNR (40-50dB): "
-                  << (*std::min_element(metrics.skewness_errors.end() - 3, metrics.skewness_errors.end())) * 100 << "% (skew), "
-                  << (*std::min_element(metrics.kurtosis_errors.end() - 3, metrics.kurtosis_errors.end())) * 100 << "% (kurt)";
+        std::cout << "\nСредняя ошибка при высоком SNR (" << snr_levels[n - edge] << "-" << snr_levels.back() << "dB): "
+                  << (*std::min_element(metrics.skewness_errors.end() - edge, metrics.skewness_errors.end())) * 100 << "% (skew), "
+                  << (*std::min_element(metrics.kurtosis_errors.end() - edge, metrics.kurtosis_errors.end())) * 100 << "% (kurt)";
 
         // Находим SNR, где ошибка становится приемлемой (<10%)
         auto skew_acceptable = std::find_if(metrics.skewness_errors.begin(), metrics.skewness_errors.end(),
@@ -368,6 +678,39 @@ void analyzeErrorMetrics(const std::vector<CollageErrorMetrics> &all_metrics)
             std::cout << "\nКуртозис становится точным (<5%) при SNR > " << snr_levels[idx] << "dB";
         }
     }
+
+    // Ошибка относительно теории без шума и относительно предсказания с шумом
+    bool header_printed = false;
+    for (const auto &metrics : all_metrics)
+    {
+        if (metrics.mean_skewness_error_predicted < 0.0)
+            continue;
+        if (!header_printed)
+        {
+            std::cout << "\n\n===== Ошибка относительно предсказания с учётом шума =====";
+            header_printed = true;
+        }
+        std::cout << "\nd" << metrics.distribution << " SNR " << metrics.snr_db << "dB: "
+                  << metrics.mean_skewness_error * 100 << "% / " << metrics.mean_skewness_error_predicted * 100 << "% (skew), "
+                  << metrics.mean_kurtosis_error * 100 << "% / " << metrics.mean_kurtosis_error_predicted * 100 << "% (kurt)";
+    }
+
+    // Ошибка, внесённая компактным форматом хранения (float16/scaled16)
+    header_printed = false;
+    for (const auto &metrics : all_metrics)
+    {
+        if (metrics.storage_max_skewness_error < 0.0)
+            continue;
+        if (!header_printed)
+        {
+            std::cout << "\n\n===== Ошибка хранения относительно float32 =====";
+            header_printed = true;
+        }
+        std::cout << "\nd" << metrics.distribution << " SNR " << metrics.snr_db << "dB (" << metrics.storage_format << "): "
+                  << metrics.storage_max_skewness_error << " (skew), "
+                  << metrics.storage_max_kurtosis_error << " (kurt)";
+    }
+    std::cout << std::endl;
 }
 
 void exportToCSV(const std::vector<CollageErrorMetrics> &metrics,
@@ -375,6 +718,7 @@ void exportToCSV(const std::vector<CollageErrorMetrics> &metrics,
                  bool includeHeader = true)
 {
 
+    TRACE_SCOPE("file.write");
     std::ofstream file(filename);
     if (!file.is_open())
     {
@@ -388,7 +732,7 @@ void exportToCSV(const std::vector<CollageErrorMetrics> &metrics,
     // Заголовок CSV
     if (includeHeader)
     {
-        file << "Distribution,SNR_dB,MeanSkewnessError,MeanKurtosisError\n";
+        file << "Distribution,SNR_dB,MeanSkewnessError,MeanKurtosisError,SkewnessCICoverage,KurtosisCICoverage,MeanSkewnessErrorVsPredicted,MeanKurtosisErrorVsPredicted,Storage,StorageMaxSkewnessError,StorageMaxKurtosisError,Replicates\n";
     }
 
     // Запись данных
@@ -397,20 +741,116 @@ void exportToCSV(const std::vector<CollageErrorMetrics> &metrics,
         file << m.distribution << ","
              << m.snr_db << ","
              << m.mean_skewness_error << ","
-             << m.mean_kurtosis_error << "\n";
+             << m.mean_kurtosis_error << ",";
+        // Без интервалов в eval поля покрытия остаются пустыми
+        if (m.skewness_ci_coverage >= 0.0)
+            file << m.skewness_ci_coverage << "," << m.kurtosis_ci_coverage;
+        else
+            file << ",";
+        file << ",";
+        if (m.mean_skewness_error_predicted >= 0.0)
+            file << m.mean_skewness_error_predicted << "," << m.mean_kurtosis_error_predicted;
+        else
+            file << ",";
+        file << "," << m.storage_format << ",";
+        if (m.storage_max_skewness_error >= 0.0)
+            file << m.storage_max_skewness_error << "," << m.storage_max_kurtosis_error;
+        else
+            file << ",";
+        file << "," << m.replicates;
+        file << "\n";
     }
 
     std::cout << "Exported " << metrics.size() << " records to " << filename << std::endl;
 }
 
-int main()
+int main(int argc, char **argv)
 {
     std::vector<int> distributions = {0, 1, 2};
     std::vector<double> snr_levels = {0, 5, 10, 15, 20, 25, 30, 35, 40, 45, 50};
 
-    std::vector<CollageErrorMetrics> all_metrics = collectAllErrorMetrics(distributions, snr_levels);
-    analyzeErrorMetrics(all_metrics);
-    exportToCSV(all_metrics, "../src/assessment/metrics.csv");
+    // --merge <sweep_dir>: результаты sweep вместо ../src/gt и ../src/evaluations
+    // --report <name>: графики и index.html в ../src/assessment/<name>, без окон
+    // --show: показать сводный график в окне (ждёт нажатия клавиши)
+    // --pool seed,snr: объединить сводки ячеек по зёрнам и/или уровням SNR
+    std::string merge_dir, report_name;
+    ReportOptions report;
+    bool show = false;
+    bool pool = false, pool_seeds = false, pool_snr = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--merge" && i + 1 < argc)
+            merge_dir = argv[++i];
+        else if (arg == "--report" && i + 1 < argc)
+            report_name = argv[++i];
+        else if (arg == "--format" && i + 1 < argc)
+        {
+            if (!parseReportFormat(argv[++i], report.format))
+            {
+                std::cerr << "Unknown report format: " << argv[i] << " (png, svg)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--show")
+            show = true;
+        else if (arg == "--pool" && i + 1 < argc)
+        {
+            pool = true;
+            std::stringstream dims(argv[++i]);
+            std::string dim;
+            while (std::getline(dims, dim, ','))
+            {
+                if (dim == "seed")
+                    pool_seeds = true;
+                else if (dim == "snr")
+                    pool_snr = true;
+                else if (dim != "none")
+                {
+                    std::cerr << "Unknown pool dimension: " << dim << " (seed, snr, none)" << std::endl;
+                    return 1;
+                }
+            }
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--merge sweep_dir] [--report name] [--format png|svg] [--show]"
+                      << " [--pool seed,snr]" << std::endl;
+            return 1;
+        }
+    }
 
+    // Shard'ы sweep разбираются один раз: их используют и --merge, и --pool
+    const std::vector<json> sweep_entries = merge_dir.empty() ? std::vector<json>() : loadSweepResults(merge_dir);
+    std::vector<CollageErrorMetrics> all_metrics = merge_dir.empty()
+                                                       ? collectAllErrorMetrics(distributions, snr_levels)
+                                                       : mergeSweepResults(sweep_entries, merge_dir);
+    analyzeErrorMetrics(all_metrics, show);
+    exportToCSV(all_metrics, merge_dir.empty() ? "../src/assessment/metrics.csv"
+                                               : (fs::path(merge_dir) / "metrics.csv").string());
+
+    if (pool)
+    {
+        const json groups = merge_dir.empty()
+                                ? poolSketches(loadEvaluationEntries(distributions, snr_levels), pool_seeds, pool_snr)
+                                : poolSketches(sweep_entries, pool_seeds, pool_snr);
+        printPooledSketches(groups);
+        const std::string pooled_path = merge_dir.empty() ? "../src/assessment/pooled.json"
+                                                          : (fs::path(merge_dir) / "pooled.json").string();
+        std::ofstream pooled_file(pooled_path);
+        pooled_file << groups.dump(4) << std::endl;
+        std::cout << "Pooled " << groups.size() << " groups to " << pooled_path << std::endl;
+    }
+
+    if (!report_name.empty())
+    {
+        report.directory = "../src/assessment/" + report_name;
+        std::vector<ReportPlot> plots = buildReportPlots(all_metrics);
+        int written = writeReport(plots, report);
+        std::cout << "Report: " << written << " of " << plots.size() << " plots written to "
+                  << report.directory << "/index.html" << std::endl;
+    }
+
+    TRACE_FLUSH();
     return 0;
-}
\ No newline at end of file
+}
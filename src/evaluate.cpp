@@ -4,85 +4,18 @@
 #include <iostream>
 #include <fstream>
 #include <iomanip>
-#include <methods.h>
+#include <filesystem>
+#include <csignal>
+#include <evaluator.h>
+#include <trace.h>
+#include <stream.h>
+#include <bootstrap.h>
+#include <storage.h>
+#include <server.h>
 
-using json = nlohmann::json;
-
-cv::Mat createCollageMask()
-{
-    const int cell_size = 256;
-    const int roi_size = 228;
-    const int border = (cell_size - roi_size) / 2; // (256-228)/2 = 14
-
-    cv::Mat mask(1280, 1280, CV_8UC1, cv::Scalar(0));
-
-    for (int row = 0; row < 5; row++)
-    {
-        for (int col = 0; col < 5; col++)
-        {
-            // Координаты ROI внутри ячейки
-            int x_start = col * cell_size + border;
-            int y_start = row * cell_size + border;
-
-            // Создаем белый квадрат ROI
-            cv::Rect roi_rect(x_start, y_start, roi_size, roi_size);
-            mask(roi_rect).setTo(cv::Scalar(255));
-        }
-    }
-    return mask;
-}
-
-json evaluateCollage(const cv::Mat &collage, const cv::Mat &mask)
-{
-    json j_result;
-    std::vector<json> cells_array;
-
-    const int cell_size = 256;
-    const int roi_size = 228;
-    const int border = (cell_size - roi_size) / 2;
-
-    for (int row = 0; row < 5; row++)
-    {
-        for (int col = 0; col < 5; col++)
-        {
-            // Координаты ячейки
-            cv::Rect cell_rect(col * cell_size, row * cell_size, cell_size, cell_size);
-
-            // Координаты ROI внутри ячейки
-            cv::Rect roi_rect(
-                col * cell_size + border,
-                row * cell_size + border,
-                roi_size,
-                roi_size);
-
-            // Создаем маску для текущей ячейки
-            cv::Mat cell_mask = mask(roi_rect).clone();
-
-            // Вырезаем ROI изображения
-            cv::Mat cell_roi = collage(roi_rect);
-
-            // Преобразуем в float для вычислений
-            cv::Mat cell_float;
-            cell_roi.convertTo(cell_float, CV_32F);
-
-            // Вычисляем статистики
-            double skewness = getSkewnessValue(cell_float, cell_mask);
-            double kurtosis = getKurtosisValue(cell_float, cell_mask);
-
-            // Добавляем в JSON
-            json j_cell;
-            j_cell["row"] = row;
-            j_cell["column"] = col;
-            j_cell["evaluated_skewness"] = skewness;
-            j_cell["evaluated_kurtosis"] = kurtosis;
-
-            cells_array.push_back(j_cell);
-        }
-    }
+namespace fs = std::filesystem;
 
-    j_result["cells"] = cells_array;
-    return j_result;
-}
+using json = nlohmann::json;
 
 void processAllCollages()
 {
@@ -99,7 +32,11 @@ void processAllCollages()
             // Загрузка коллажа
             std::string filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB.tiff";
             std::string image_path = "../src/test_images/" + filename;
-            cv::Mat collage = cv::imread(image_path, cv::IMREAD_UNCHANGED);
+            cv::Mat collage;
+            {
+                TRACE_SCOPE("io.imread");
+                collage = cv::imread(image_path, cv::IMREAD_UNCHANGED);
+            }
 
             if (collage.empty())
             {
@@ -113,8 +50,16 @@ void processAllCollages()
             // Сохранение результатов
             std::string out_filename = "d" + std::to_string(dist) + "_snr" + std::to_string((int)snr_db) + "dB_eval.json";
             std::string out_path = "../src/evaluations/" + out_filename;
-            std::ofstream out_file(out_path);
-            out_file << std::setw(4) << evaluation << std::endl;
+            std::string evaluation_text;
+            {
+                TRACE_SCOPE("json.serialize");
+                evaluation_text = evaluation.dump(4);
+            }
+            {
+                TRACE_SCOPE("file.write");
+                std::ofstream out_file(out_path);
+                out_file << evaluation_text << std::endl;
+            }
 
             std::cout << "Processed: " << out_path << std::endl;
         }
@@ -126,19 +71,230 @@ void processAllCollages()
 //     return 0;
 // }
 
+// Оценка одного коллажа: по фиксированной маске или по найденной раскладке;
+// при заданном bootstrap к ячейкам добавляются доверительные интервалы
+static bool evaluateFile(const std::string &image_path, const std::string &eval_path,
+                         LayoutCache *layouts, const EvaluationOptions &options)
+{
+    // Компактные форматы (float16, scaled16) оцениваются без перевода в float32
+    StorageInfo storage;
+    cv::Mat image = readStoredCollage(image_path, storage);
+    if (image.empty())
+    {
+        std::cerr << "Error loading: " << image_path << std::endl;
+        return false;
+    }
+
+    static const CollageLayout fixed_layout = layoutFromMask(createCollageMask());
+    std::shared_ptr<const CollageLayout> detected;
+    if (layouts)
+        detected = layouts->get(image, options.layout_key);
+    const CollageLayout &layout = detected ? *detected : fixed_layout;
+
+    try
+    {
+        if (!writeEvaluation(eval_path, image, storage, layout, options))
+        {
+            std::cerr << "Error opening: " << eval_path << std::endl;
+            return false;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error evaluating " << image_path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Потоковый режим: NDJSON в stdout, сводка по задержкам в stderr
+static int runStream(int argc, char **argv)
+{
+    StreamOptions options;
+    options.source = argv[2];
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--auto-layout")
+            options.auto_layout = true;
+        else if (arg == "--layout-key" && i + 1 < argc)
+            options.layout_key = argv[++i];
+        else if (arg == "--queue" && i + 1 < argc)
+            options.queue_capacity = std::stoul(argv[++i]);
+        else if (arg == "--max-frames" && i + 1 < argc)
+            options.max_frames = std::stoll(argv[++i]);
+        else if (arg == "--raw" && i + 1 < argc)
+        {
+            std::string size = argv[++i];
+            size_t x = size.find('x');
+            if (x == std::string::npos)
+            {
+                std::cerr << "Expected --raw WxH, got: " << size << std::endl;
+                return 1;
+            }
+            options.raw_size = cv::Size(std::stoi(size.substr(0, x)), std::stoi(size.substr(x + 1)));
+        }
+        else if (arg == "--raw-type" && i + 1 < argc)
+        {
+            std::string type = argv[++i];
+            if (type == "f32")
+                options.raw_type = CV_32FC1;
+            else if (type == "u16")
+                options.raw_type = CV_16UC1;
+            else if (type == "u8")
+                options.raw_type = CV_8UC1;
+            else
+            {
+                std::cerr << "Unknown raw type: " << type << " (f32, u16, u8)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--policy" && i + 1 < argc)
+        {
+            if (!parseOverflowPolicy(argv[++i], options.policy))
+            {
+                std::cerr << "Unknown policy: " << argv[i] << " (block, drop, latest)" << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    StreamStats stats = runFrameStream(options, std::cout);
+
+    json summary;
+    summary["frames_read"] = stats.frames_read;
+    summary["frames_processed"] = stats.frames_processed;
+    summary["frames_dropped"] = stats.frames_dropped;
+    summary["frames_wrong_size"] = stats.frames_wrong_size;
+    summary["frames_failed"] = stats.frames_failed;
+    summary["latency"] = stats.latency.toJson();
+    if (!stats.error.empty())
+        summary["error"] = stats.error;
+    std::cerr << summary.dump() << std::endl;
+
+    TRACE_FLUSH();
+    return stats.error.empty() ? 0 : 1;
+}
+
+// Режим сервера: запросы через Unix-сокет, сводка по задержкам в stderr
+static int runServe(const std::string &socket_path)
+{
+    std::signal(SIGINT, [](int)
+                { requestServerStop(); });
+    std::signal(SIGTERM, [](int)
+                { requestServerStop(); });
+
+    ServerOptions options;
+    options.socket_path = socket_path;
+    std::cerr << "Listening on " << socket_path << std::endl;
+    ServerStats stats = runEvalServer(options);
+    std::cerr << stats.toJson().dump() << std::endl;
+
+    TRACE_FLUSH();
+    return 0;
+}
+
+// Клиент сервера: тот же вызов, что и "eval image eval", без запуска оценки в процессе
+static int runConnect(int argc, char **argv)
+{
+    if (argc < 5)
+    {
+        std::cerr << "Expected socket path, image path and eval path." << std::endl;
+        return 1;
+    }
+    // Параметры проверяются здесь же, чтобы ошибка была видна до соединения;
+    // сервер разбирает их тем же parseEvaluationOptions
+    const std::vector<std::string> args(argv + 5, argv + argc);
+    EvaluationOptions options;
+    std::string error;
+    if (!parseEvaluationOptions(args, options, error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    json request;
+    request["image"] = fs::absolute("../src/test_images/" + std::string(argv[3])).string();
+    request["output"] = fs::absolute("../src/evaluations/" + std::string(argv[4])).string();
+    request["args"] = args;
+
+    json response = sendServerRequest(argv[2], request);
+    if (!response.value("ok", false))
+    {
+        std::cerr << "Server error: " << response.value("error", "unknown") << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    if (argc < 3)
     {
-        std::cerr << "Usage: " << argv[0] << " [image_path] [eval_path] " << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [image_path] [eval_path] [options]\n"
+                  << "       " << argv[0] << " --batch [list_file] [options]\n"
+                  << "       " << argv[0] << " --stream [source] [--raw WxH] [--raw-type f32|u16|u8] [--queue N]\n"
+                  << "              [--policy block|drop|latest] [--max-frames N] [--auto-layout] [--layout-key key]\n"
+                  << "options: [--auto-layout] [--layout-key key]\n"
+                  << "         [--bootstrap N | --jackknife] [--block-size px] [--confidence 0.95] [--ci-seed seed]\n"
+                  << "         [--approx tolerance] [--approx-max-fraction 0.05] [--approx-seed seed]\n"
+                  << "         [--stats skewness,kurtosis,bowley,medcouple,l_skewness,l_kurtosis|all] [--sketch] [--ndjson]\n"
+                  << "list_file: one \"image_path eval_path\" pair per line\n"
+                  << "       " << argv[0] << " --serve [socket_path]\n"
+                  << "       " << argv[0] << " --connect [socket_path] [image_path] [eval_path] [options]\n"
+                  << "source: video file, camera index, image pattern (img_%04d.tiff), directory or - for raw stdin"
+                  << std::endl;
         return 1;
     }
 
+    if (std::string(argv[1]) == "--stream")
+        return runStream(argc, argv);
+    if (std::string(argv[1]) == "--serve")
+        return runServe(argv[2]);
+    if (std::string(argv[1]) == "--connect")
+        return runConnect(argc, argv);
+
+    EvaluationOptions options;
+    std::string error;
+    if (!parseEvaluationOptions(std::vector<std::string>(argv + 3, argv + argc), options, error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    // Раскладка ищется один раз на подпись и переиспользуется для всех изображений
+    LayoutCache layouts;
+    LayoutCache *cache = options.auto_layout ? &layouts : nullptr;
+
+    if (std::string(argv[1]) == "--batch")
+    {
+        std::ifstream list(argv[2]);
+        if (!list.is_open())
+        {
+            std::cerr << "Error opening list: " << argv[2] << std::endl;
+            return 1;
+        }
+        int failed = 0;
+        std::string image_name, eval_name;
+        while (list >> image_name >> eval_name)
+        {
+            if (!evaluateFile("../src/test_images/" + image_name, "../src/evaluations/" + eval_name,
+                              cache, options))
+                failed++;
+        }
+        if (options.auto_layout)
+            std::cout << "Layouts detected: " << layouts.size() << std::endl;
+        TRACE_FLUSH();
+        return failed == 0 ? 0 : 1;
+    }
+
     std::string image_path = argv[1];
     image_path = "../src/test_images/" + image_path;
-    cv::Mat image = cv::imread(image_path, cv::IMREAD_UNCHANGED);
     std::string eval_path = argv[2];
     eval_path = "../src/evaluations/" + eval_path;
 
-    evaluateCollage(image, createCollageMask());
+    bool ok = evaluateFile(image_path, eval_path, cache, options);
+
+    TRACE_FLUSH();
+    return ok ? 0 : 1;
 }
@@ -1,6 +1,12 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
 #include <generator.h>
+#include <trace.h>
+#include <evaluator.h>
+#include <storage.h>
+#include <sweep.h>
 
 // int main() {
 //     ImageGenerator generator(42);
@@ -10,10 +16,49 @@
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <config_path> [image_path] [gt_path] [--seed seed_value]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <config_path> [image_path] [gt_path] [--seed seed_value] [--ndjson]\n"
+                  << "       " << argv[0] << " --predict <output_path> [manifest_path]" << std::endl;
         return 1;
     }
 
+    // Предсказание моментов без генерации изображений; распределения, уровни SNR
+    // и сетка берутся из манифеста прогона (sweep.h), без него — значения по умолчанию
+    if (std::string(argv[1]) == "--predict") {
+        if (argc < 3) {
+            std::cerr << "Expected output path for predictions." << std::endl;
+            return 1;
+        }
+        std::string predict_path = argv[2];
+        predict_path = "../src/assessment/" + predict_path;
+
+        SweepManifest manifest;
+        if (argc > 3) {
+            std::ifstream manifest_file(argv[3]);
+            if (!manifest_file.is_open()) {
+                std::cerr << "Error opening manifest: " << argv[3] << std::endl;
+                return 1;
+            }
+            try {
+                manifest = parseSweepManifest(json::parse(manifest_file));
+            } catch (const std::exception &e) {
+                std::cerr << "Invalid manifest " << argv[3] << ": " << e.what() << std::endl;
+                return 1;
+            }
+        }
+
+        json predictions = ImageGenerator::predictAll(manifest.distributions, manifest.snr_levels, manifest.grid);
+        std::ofstream predict_file(predict_path);
+        predict_file << std::setw(4) << predictions << std::endl;
+
+        for (const auto &p : predictions) {
+            std::cout << "d" << p["distribution"].get<int>() << " snr " << p["snr_db"].get<double>() << "dB: "
+                      << p["predicted_mean_skewness_error"].get<double>() * 100 << "% (skew), "
+                      << p["predicted_mean_kurtosis_error"].get<double>() * 100 << "% (kurt)\n";
+        }
+        std::cout << "Predictions written to " << predict_path << std::endl;
+        return 0;
+    }
+
     std::string config_path = argv[1];
     config_path = "../src/config/" + config_path;
 
@@ -34,24 +79,33 @@ int main(int argc, char** argv) {
     gt_path = "../src/gt/" + gt_path;
 
     int seed = -1;
+    bool ndjson = false;
     for (int i = 4; i < argc; ++i) {
-        if (std::string(argv[i]) == "--seed" && i + 1 < argc) {
-            seed = std::stoi(argv[i + 1]);
-            break;
-        }
+        if (std::string(argv[i]) == "--seed" && i + 1 < argc)
+            seed = std::stoi(argv[++i]);
+        else if (std::string(argv[i]) == "--ndjson")
+            ndjson = true;
     }
 
     ImageGenerator generator(config_path, seed);
-    cv::Mat image = generator.generate_collage(gt_path);
+    cv::Mat image = generator.generate_collage(gt_path, ndjson);
 
-    if (!cv::imwrite(image_path, image)) {
-        throw std::runtime_error("Failed to save image to: " + image_path);
-    }
+    // Компактный формат хранения задаётся ключом "storage" в конфиге
+    CollageLayout layout = layoutFromMask(createCollageMask());
+    json storage = writeCollage(image_path, image, generator.storageFormat(), &layout);
 
     std::cout << "Successfully generated:\n"
               << "Image: " << image_path << "\n"
               << "Ground truth: " << gt_path << std::endl;
 
+    if (storage.contains("moment_error")) {
+        std::cout << "Storage: " << storage["format"].get<std::string>()
+                  << ", max error vs float32: "
+                  << storage["moment_error"]["max_skewness_error"].get<double>() << " (skew), "
+                  << storage["moment_error"]["max_kurtosis_error"].get<double>() << " (kurt)" << std::endl;
+    }
+
+    TRACE_FLUSH();
     return 0;
 
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include <opencv2/opencv.hpp>
+#include <nlohmann/json.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sweep.h>
+#include <trace.h>
+
+using json = nlohmann::json;
+
+// Локальный запуск нескольких рабочих процессов; на других хостах
+// с тем же каталогом достаточно запустить "sweep work" ещё раз
+static int runWorkers(const std::string &sweep_dir, const SweepWorkerOptions &options, int jobs)
+{
+    if (jobs <= 1)
+    {
+        int processed = runSweepWorker(sweep_dir, options);
+        std::cout << "Processed " << processed << " item(s)" << std::endl;
+        return 0;
+    }
+
+    std::vector<pid_t> children;
+    for (int i = 0; i < jobs; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            std::cerr << "fork failed" << std::endl;
+            break;
+        }
+        if (pid == 0)
+        {
+            int code = 0;
+            try
+            {
+                runSweepWorker(sweep_dir, options);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Worker failed: " << e.what() << std::endl;
+                code = 1;
+            }
+            TRACE_FLUSH();
+            _exit(code);
+        }
+        children.push_back(pid);
+    }
+
+    int failed = 0;
+    for (pid_t pid : children)
+    {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+    SweepStatus status = sweepStatus(sweep_dir);
+    std::cout << "Done " << status.done << ", claimed " << status.claimed << ", pending " << status.pending
+              << (failed ? ", failed workers: " + std::to_string(failed) : "") << std::endl;
+    return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " init [manifest_path] [sweep_dir]\n"
+                  << "       " << argv[0] << " work [sweep_dir] [--jobs N] [--worker id] [--lease seconds] [--poll ms] [--max-items N]\n"
+                  << "       " << argv[0] << " status [sweep_dir]\n"
+                  << "Results are merged with: ass --merge [sweep_dir]" << std::endl;
+        return 1;
+    }
+
+    const std::string command = argv[1];
+    if (command == "init")
+    {
+        if (argc < 4)
+        {
+            std::cerr << "Expected manifest path and sweep directory." << std::endl;
+            return 1;
+        }
+        int queued = initSweep(argv[2], argv[3]);
+        std::cout << "Queued " << queued << " item(s) in " << argv[3] << std::endl;
+        return 0;
+    }
+
+    if (command == "status")
+    {
+        SweepStatus status = sweepStatus(argv[2]);
+        json j;
+        j["pending"] = status.pending;
+        j["claimed"] = status.claimed;
+        j["done"] = status.done;
+        std::cout << j.dump() << std::endl;
+        return 0;
+    }
+
+    if (command == "work")
+    {
+        SweepWorkerOptions options;
+        int jobs = 1;
+        try
+        {
+            for (int i = 3; i < argc; ++i)
+            {
+                std::string arg = argv[i];
+                if (arg == "--jobs" && i + 1 < argc)
+                    jobs = std::stoi(argv[++i]);
+                else if (arg == "--worker" && i + 1 < argc)
+                    options.worker_id = argv[++i];
+                else if (arg == "--lease" && i + 1 < argc)
+                    options.lease_seconds = std::stoi(argv[++i]);
+                else if (arg == "--poll" && i + 1 < argc)
+                    options.poll_ms = std::stoi(argv[++i]);
+                else if (arg == "--max-items" && i + 1 < argc)
+                    options.max_items = std::stoi(argv[++i]);
+                else
+                {
+                    std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+                    return 1;
+                }
+            }
+        }
+        catch (const std::exception &)
+        {
+            std::cerr << "Invalid numeric value in options" << std::endl;
+            return 1;
+        }
+        if (jobs < 1 || options.lease_seconds <= 0 || options.poll_ms < 0)
+        {
+            std::cerr << "--jobs and --lease must be positive, --poll non-negative" << std::endl;
+            return 1;
+        }
+        int code = runWorkers(argv[2], options, jobs);
+        TRACE_FLUSH();
+        return code;
+    }
+
+    std::cerr << "Unknown command: " << command << std::endl;
+    return 1;
+}
@@ -0,0 +1,47 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// Минимальные проверки для ctest без внешних зависимостей: сбой печатается
+// с местом и значениями, main возвращает checkResult()
+
+#include <cmath>
+#include <iostream>
+
+inline int &checkFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline int checkResult()
+{
+    if (checkFailures() > 0)
+        std::cerr << checkFailures() << " check(s) failed" << std::endl;
+    return checkFailures() == 0 ? 0 : 1;
+}
+
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            checkFailures()++;                                                            \
+        }                                                                                 \
+    } while (0)
+
+// |actual - expected| <= tolerance; NaN всегда сбой
+#define CHECK_NEAR(actual, expected, tolerance)                                            \
+    do                                                                                     \
+    {                                                                                      \
+        const double check_actual = (actual);                                              \
+        const double check_expected = (expected);                                          \
+        if (!(std::fabs(check_actual - check_expected) <= (tolerance)))                    \
+        {                                                                                  \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " = " << check_actual \
+                      << ", expected " << check_expected << " +- " << (tolerance) << "\n"; \
+            checkFailures()++;                                                             \
+        }                                                                                  \
+    } while (0)
+
+#endif
@@ -0,0 +1,88 @@
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <vector>
+#include <methods.h>
+#include "check.h"
+
+static cv::Mat makeSample(int size, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::gamma_distribution<double> gamma(4.0, 10.0); // асимметрия 1, эксцесс 1.5
+    cv::Mat image(size, size, CV_32FC1);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            image.at<float>(y, x) = static_cast<float>(gamma(rng));
+    return image;
+}
+
+static std::vector<Span> fullSpans(int size)
+{
+    std::vector<Span> spans;
+    for (int y = 0; y < size; y++)
+        spans.push_back({y, 0, size});
+    return spans;
+}
+
+// Без ограничения бюджета и с недостижимым допуском оценка переходит к точной
+static void testExactFallback()
+{
+    const cv::Mat image = makeSample(256, 1);
+    const std::vector<Span> spans = fullSpans(256);
+    const MomentSummary exact = getChannelMoments(image, spans)[0];
+
+    ApproxOptions options;
+    options.tolerance = 1e-12;
+    options.max_fraction = 1.0;
+    const ApproxMoments m = getApproxMoments(image, spans, options);
+    CHECK(m.samples == 256 * 256);
+    CHECK(m.converged);
+    CHECK_NEAR(m.skewness, exact.skewness(), 1e-12);
+    CHECK_NEAR(m.kurtosis, exact.kurtosis(), 1e-12);
+}
+
+// Подвыборка не выходит за max_fraction, в том числе в первом раунде
+static void testBudget()
+{
+    const cv::Mat image = makeSample(256, 2);
+    const std::vector<Span> spans = fullSpans(256);
+    for (double fraction : {0.002, 0.005, 0.05})
+    {
+        ApproxOptions options;
+        options.tolerance = 1e-12;
+        options.max_fraction = fraction;
+        const ApproxMoments m = getApproxMoments(image, spans, options);
+        CHECK(m.samples <= std::llround(fraction * 256 * 256));
+        CHECK(m.samples >= options.groups);
+        CHECK(!m.converged);
+    }
+}
+
+// Оценка по подвыборке согласуется с точной в пределах заявленной ошибки
+// и воспроизводится при том же seed
+static void testAccuracy()
+{
+    const cv::Mat image = makeSample(512, 3);
+    const std::vector<Span> spans = fullSpans(512);
+    const MomentSummary exact = getChannelMoments(image, spans)[0];
+
+    ApproxOptions options;
+    options.tolerance = 0.05;
+    options.max_fraction = 0.5;
+    options.seed = 11;
+    const ApproxMoments m = getApproxMoments(image, spans, options);
+    CHECK(m.samples < 512 * 512);
+    CHECK(m.skewness_error > 0.0 && m.kurtosis_error > 0.0);
+    CHECK_NEAR(m.skewness, exact.skewness(), 5.0 * m.skewness_error);
+    CHECK_NEAR(m.kurtosis, exact.kurtosis(), 5.0 * m.kurtosis_error);
+
+    const ApproxMoments again = getApproxMoments(image, spans, options);
+    CHECK(again.skewness == m.skewness && again.kurtosis == m.kurtosis && again.samples == m.samples);
+}
+
+int main()
+{
+    testExactFallback();
+    testBudget();
+    testAccuracy();
+    return checkResult();
+}
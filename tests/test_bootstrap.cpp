@@ -0,0 +1,142 @@
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <vector>
+#include <bootstrap.h>
+#include "check.h"
+
+static cv::Mat makeSample(int size, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::exponential_distribution<double> exponential(1.0);
+    cv::Mat image(size, size, CV_32FC1);
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++)
+            image.at<float>(y, x) = static_cast<float>(exponential(rng));
+    return image;
+}
+
+static std::vector<MomentSummary> makeBlocks(int size, int block_size, unsigned seed)
+{
+    std::vector<Span> spans;
+    for (int y = 0; y < size; y++)
+        spans.push_back({y, 0, size});
+    return blockSummaries(makeSample(size, seed), spans, block_size);
+}
+
+// Блоки покрывают ROI без пропусков и повторов
+static void testBlocks()
+{
+    const std::vector<MomentSummary> blocks = makeBlocks(64, 16, 1);
+    CHECK(blocks.size() == 16);
+    double n = 0.0;
+    for (const MomentSummary &b : blocks)
+    {
+        CHECK_NEAR(b.n, 256.0, 0.0);
+        n += b.n;
+    }
+    CHECK_NEAR(n, 64.0 * 64.0, 0.0);
+}
+
+// Jackknife против прямого определения: оценки без i-го блока собираются
+// заново, SE = sqrt((n-1)/n * sum (theta_i - mean)^2)
+static void testJackknife()
+{
+    const std::vector<MomentSummary> blocks = makeBlocks(64, 16, 2);
+    const size_t n = blocks.size();
+
+    std::vector<double> skew, kurt;
+    for (size_t i = 0; i < n; i++)
+    {
+        MomentSummary without;
+        for (size_t j = 0; j < n; j++)
+            if (j != i)
+                without.merge(blocks[j]);
+        skew.push_back(without.skewness());
+        kurt.push_back(without.kurtosis());
+    }
+    auto jackknifeSe = [n](const std::vector<double> &values)
+    {
+        double mean = 0.0;
+        for (double v : values)
+            mean += v;
+        mean /= n;
+        double sum2 = 0.0;
+        for (double v : values)
+            sum2 += (v - mean) * (v - mean);
+        return std::sqrt((n - 1.0) / n * sum2);
+    };
+
+    BootstrapOptions options;
+    options.method = ResampleMethod::Jackknife;
+    options.confidence = 0.95;
+    const CellConfidence result = resampleCell(blocks, options, 0);
+    const double skew_se = jackknifeSe(skew);
+    const double kurt_se = jackknifeSe(kurt);
+    CHECK_NEAR(result.skewness.std_error, skew_se, 1e-9 * skew_se);
+    CHECK_NEAR(result.kurtosis.std_error, kurt_se, 1e-9 * kurt_se);
+
+    // Нормальный интервал: estimate -+ 1.959964 * SE
+    CHECK_NEAR(result.skewness.upper - result.skewness.estimate, 1.959964 * skew_se, 1e-5 * skew_se);
+    CHECK_NEAR(result.skewness.estimate - result.skewness.lower, 1.959964 * skew_se, 1e-5 * skew_se);
+}
+
+// Перевыборки зависят только от seed и stream, но не от числа потоков
+static void testBootstrapDeterminism()
+{
+    const std::vector<MomentSummary> blocks = makeBlocks(128, 16, 3);
+    BootstrapOptions options;
+    options.resamples = 500;
+    options.seed = 7;
+
+    const int threads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    const CellConfidence single = resampleCell(blocks, options, 42);
+    cv::setNumThreads(8);
+    const CellConfidence parallel = resampleCell(blocks, options, 42);
+    cv::setNumThreads(threads);
+
+    CHECK(single.skewness.lower == parallel.skewness.lower);
+    CHECK(single.skewness.upper == parallel.skewness.upper);
+    CHECK(single.skewness.std_error == parallel.skewness.std_error);
+    CHECK(single.kurtosis.lower == parallel.kurtosis.lower);
+    CHECK(single.kurtosis.upper == parallel.kurtosis.upper);
+
+    const CellConfidence other_stream = resampleCell(blocks, options, 43);
+    CHECK(other_stream.skewness.std_error != single.skewness.std_error);
+
+    CHECK(single.skewness.lower <= single.skewness.upper);
+    CHECK(single.skewness.std_error > 0.0);
+
+    // Бутстрэп и jackknife оценивают одну и ту же ошибку
+    BootstrapOptions jackknife;
+    jackknife.method = ResampleMethod::Jackknife;
+    const double ratio = single.skewness.std_error / resampleCell(blocks, jackknife, 0).skewness.std_error;
+    CHECK(ratio > 0.5 && ratio < 2.0);
+}
+
+// Меньше двух блоков: точечная оценка есть, интервалов нет
+static void testDegenerate()
+{
+    const std::vector<MomentSummary> blocks = makeBlocks(16, 16, 4);
+    CHECK(blocks.size() == 1);
+    for (ResampleMethod method : {ResampleMethod::Bootstrap, ResampleMethod::Jackknife})
+    {
+        BootstrapOptions options;
+        options.method = method;
+        const CellConfidence result = resampleCell(blocks, options, 0);
+        CHECK(std::isfinite(result.skewness.estimate));
+        CHECK(std::isnan(result.skewness.lower) && std::isnan(result.skewness.upper));
+        CHECK(std::isnan(result.kurtosis.std_error));
+    }
+    const CellConfidence empty = resampleCell({}, BootstrapOptions(), 0);
+    CHECK(std::isnan(empty.skewness.lower));
+}
+
+int main()
+{
+    testBlocks();
+    testJackknife();
+    testBootstrapDeterminism();
+    testDegenerate();
+    return checkResult();
+}
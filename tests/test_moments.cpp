@@ -0,0 +1,170 @@
+#include <opencv2/opencv.hpp>
+#include <random>
+#include <vector>
+#include <methods.h>
+#include "check.h"
+
+// Эталон: два прохода в long double
+static MomentSummary referenceMoments(const std::vector<double> &values)
+{
+    long double mean = 0.0L;
+    for (double v : values)
+        mean += v;
+    mean /= values.size();
+    long double m2 = 0.0L, m3 = 0.0L, m4 = 0.0L;
+    for (double v : values)
+    {
+        const long double d = v - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+    }
+    MomentSummary reference;
+    reference.n = static_cast<double>(values.size());
+    reference.mean = static_cast<double>(mean);
+    reference.M2 = static_cast<double>(m2);
+    reference.M3 = static_cast<double>(m3);
+    reference.M4 = static_cast<double>(m4);
+    return reference;
+}
+
+// Скошенная выборка: экспоненциальное плюс нормальное, сдвинутое на offset
+static cv::Mat makeSample(int rows, int cols, double offset, unsigned seed, int type = CV_64FC1)
+{
+    std::mt19937 rng(seed);
+    std::exponential_distribution<double> exponential(1.0);
+    std::normal_distribution<double> normal(0.0, 0.5);
+    cv::Mat image(rows, cols, CV_64FC1);
+    for (int y = 0; y < rows; y++)
+        for (int x = 0; x < cols; x++)
+            image.at<double>(y, x) = offset + exponential(rng) + normal(rng);
+    cv::Mat converted;
+    image.convertTo(converted, type);
+    return converted;
+}
+
+static std::vector<Span> rowSpans(int y0, int y1, int width)
+{
+    std::vector<Span> spans;
+    for (int y = y0; y < y1; y++)
+        spans.push_back({y, 0, width});
+    return spans;
+}
+
+// Значения под отрезками после приведения к double (как их видит оценка)
+static std::vector<double> valuesOf(const cv::Mat &image, const std::vector<Span> &spans)
+{
+    cv::Mat image64;
+    image.convertTo(image64, CV_64F);
+    std::vector<double> values;
+    for (const Span &s : spans)
+        for (int x = s.x0; x < s.x1; x++)
+            values.push_back(image64.at<double>(s.y, x));
+    return values;
+}
+
+static void checkSame(const MomentSummary &actual, const MomentSummary &expected, double relative)
+{
+    CHECK_NEAR(actual.n, expected.n, 0.0);
+    CHECK_NEAR(actual.mean, expected.mean, relative * std::max(1.0, std::fabs(expected.mean)));
+    CHECK_NEAR(actual.M2, expected.M2, relative * std::fabs(expected.M2));
+    CHECK_NEAR(actual.M3, expected.M3, relative * std::fabs(expected.M3));
+    CHECK_NEAR(actual.M4, expected.M4, relative * std::fabs(expected.M4));
+}
+
+// Один проход по степенным суммам совпадает с двухпроходным эталоном
+static void testSinglePass()
+{
+    const cv::Mat image = makeSample(64, 64, 0.0, 1);
+    const std::vector<Span> spans = rowSpans(0, 64, 64);
+    const MomentSummary reference = referenceMoments(valuesOf(image, spans));
+    const MomentSummary m = getChannelMoments(image, spans)[0];
+    checkSame(m, reference, 1e-10);
+    CHECK_NEAR(m.skewness(), reference.skewness(), 1e-10);
+    CHECK_NEAR(m.kurtosis(), reference.kurtosis(), 1e-10);
+}
+
+// merge(A, B) равен одному проходу по A и B; пустая сводка — нейтральный элемент
+static void testMerge()
+{
+    const cv::Mat image = makeSample(64, 64, 10.0, 2);
+    const MomentSummary all = getChannelMoments(image, rowSpans(0, 64, 64))[0];
+    const MomentSummary a = getChannelMoments(image, rowSpans(0, 20, 64))[0];
+    const MomentSummary b = getChannelMoments(image, rowSpans(20, 64, 64))[0];
+
+    MomentSummary ab = a;
+    ab.merge(b);
+    checkSame(ab, all, 1e-10);
+
+    MomentSummary ba = b;
+    ba.merge(a);
+    checkSame(ba, all, 1e-10);
+
+    MomentSummary empty;
+    empty.merge(a);
+    checkSame(empty, a, 0.0);
+    MomentSummary unchanged = a;
+    unchanged.merge(MomentSummary());
+    checkSame(unchanged, a, 0.0);
+}
+
+// Сдвиг степенных сумм сохраняет точность при большом среднем
+static void testLargeOffset()
+{
+    for (int type : {CV_32FC1, CV_64FC1})
+    {
+        const cv::Mat image = makeSample(64, 64, type == CV_32FC1 ? 1e4 : 1e6, 3, type);
+        const std::vector<Span> spans = rowSpans(0, 64, 64);
+        const MomentSummary reference = referenceMoments(valuesOf(image, spans));
+        const MomentSummary m = getChannelMoments(image, spans)[0];
+        CHECK_NEAR(m.skewness(), reference.skewness(), 1e-6);
+        CHECK_NEAR(m.kurtosis(), reference.kurtosis(), 1e-6);
+    }
+}
+
+// Произвольная маска: отрезки из maskToSpans покрывают ровно её пиксели
+static void testMask()
+{
+    const cv::Mat image = makeSample(96, 96, 5.0, 4);
+    cv::Mat mask(image.size(), CV_8UC1, cv::Scalar(0));
+    cv::circle(mask, cv::Point(48, 48), 30, cv::Scalar(255), -1);
+    cv::rectangle(mask, cv::Rect(5, 5, 7, 40), cv::Scalar(255), -1);
+
+    std::vector<double> values;
+    for (int y = 0; y < mask.rows; y++)
+        for (int x = 0; x < mask.cols; x++)
+            if (mask.at<uchar>(y, x))
+                values.push_back(image.at<double>(y, x));
+    checkSame(getChannelMoments(image, mask)[0], referenceMoments(values), 1e-10);
+}
+
+// Каналы чередующегося изображения и глубины считаются как отдельные плоскости в double
+static void testChannelsAndDepths()
+{
+    std::vector<cv::Mat> planes;
+    for (unsigned seed = 10; seed < 13; seed++)
+        planes.push_back(makeSample(48, 48, 100.0 * seed, seed, CV_32FC1));
+    cv::Mat interleaved;
+    cv::merge(planes, interleaved);
+    const std::vector<Span> spans = rowSpans(0, 48, 48);
+    const std::vector<MomentSummary> channels = getChannelMoments(interleaved, spans);
+    CHECK(channels.size() == 3);
+    for (size_t c = 0; c < channels.size() && c < planes.size(); c++)
+        checkSame(channels[c], referenceMoments(valuesOf(planes[c], spans)), 1e-10);
+
+    for (int depth : {CV_8U, CV_16U, CV_16S})
+    {
+        const cv::Mat image = makeSample(48, 48, 100.0, 20, depth);
+        checkSame(getChannelMoments(image, spans)[0], referenceMoments(valuesOf(image, spans)), 1e-10);
+    }
+}
+
+int main()
+{
+    testSinglePass();
+    testMerge();
+    testLargeOffset();
+    testMask();
+    testChannelsAndDepths();
+    return checkResult();
+}
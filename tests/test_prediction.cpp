@@ -0,0 +1,83 @@
+#include <cmath>
+#include <vector>
+#include <prediction.h>
+#include "check.h"
+
+// Без шума — моменты самих распределений в замкнутой форме
+static void testNoiseless()
+{
+    const PredictedMoments normal = predictNoisyMoments(signalCumulants(0, 100.0, 2.0), 0.0);
+    CHECK_NEAR(normal.skewness, 0.0, 1e-12);
+    CHECK_NEAR(normal.kurtosis, 0.0, 1e-12);
+
+    // Равномерное: избыточный эксцесс -6/5 при любой ширине
+    for (double stddev : {0.5, 2.0, 30.0})
+    {
+        const PredictedMoments uniform = predictNoisyMoments(signalCumulants(1, 100.0, stddev), 0.0);
+        CHECK_NEAR(uniform.skewness, 0.0, 1e-12);
+        CHECK_NEAR(uniform.kurtosis, -1.2, 1e-12);
+    }
+
+    // Экспоненциальное: асимметрия 2, эксцесс 6 при любом среднем
+    for (double mean : {0.5, 44.0, 220.0})
+    {
+        const PredictedMoments exponential = predictNoisyMoments(signalCumulants(2, mean, 1.0), 0.0);
+        CHECK_NEAR(exponential.skewness, 2.0, 1e-12);
+        CHECK_NEAR(exponential.kurtosis, 6.0, 1e-12);
+    }
+}
+
+// Гауссов шум добавляет только k2: при SNR 0 дБ дисперсия удваивается,
+// асимметрия делится на 2^1.5, эксцесс — на 4
+static void testNoise()
+{
+    CHECK_NEAR(noiseStddev(4.0, 0.0), 2.0, 1e-12);
+    CHECK_NEAR(noiseStddev(4.0, 10.0), std::sqrt(0.4), 1e-12);
+    CHECK_NEAR(noiseStddev(4.0, 20.0), 0.2, 1e-12);
+
+    const PredictedMoments uniform = predictCellMoments(1, 100.0, 3.0, 0.0);
+    CHECK_NEAR(uniform.kurtosis, -1.2 / 4.0, 1e-12);
+
+    const PredictedMoments exponential = predictCellMoments(2, 5.0, 5.0, 0.0);
+    CHECK_NEAR(exponential.skewness, 2.0 / std::pow(2.0, 1.5), 1e-12);
+    CHECK_NEAR(exponential.kurtosis, 6.0 / 4.0, 1e-12);
+
+    // SNR s дБ: k2 растёт в (1 + 10^(-s/10)) раз
+    const double snr_db = 7.0;
+    const double growth = 1.0 + std::pow(10.0, -snr_db / 10.0);
+    const PredictedMoments noisy = predictCellMoments(2, 5.0, 5.0, snr_db);
+    CHECK_NEAR(noisy.skewness, 2.0 / std::pow(growth, 1.5), 1e-12);
+    CHECK_NEAR(noisy.kurtosis, 6.0 / (growth * growth), 1e-12);
+}
+
+// Шум коллажа считается по дисперсии смеси ячеек и нулевого фона
+static void testCollage()
+{
+    // Одна ячейка на всё изображение — то же, что модель отдельной ячейки
+    const std::vector<PredictedMoments> single = predictCollageMoments(1, 10.0, {{100.0, 3.0}}, 1.0);
+    CHECK(single.size() == 1);
+    CHECK_NEAR(single[0].kurtosis, predictCellMoments(1, 100.0, 3.0, 10.0).kurtosis, 1e-12);
+
+    // Две ячейки по четверти изображения: E[x] = 0.25(m1 + m2),
+    // E[x^2] = 0.25(s1^2 + m1^2 + s2^2 + m2^2)
+    const std::vector<CellSpec> cells = {{40.0, 2.0}, {80.0, 4.0}};
+    const double ex = 0.25 * (40.0 + 80.0);
+    const double ex2 = 0.25 * (4.0 + 1600.0 + 16.0 + 6400.0);
+    const double noise_var = (ex2 - ex * ex) / std::pow(10.0, 20.0 / 10.0);
+    const std::vector<PredictedMoments> collage = predictCollageMoments(1, 20.0, cells, 0.25);
+    CHECK(collage.size() == 2);
+    for (size_t i = 0; i < collage.size() && i < cells.size(); i++)
+    {
+        const double var = cells[i].stddev * cells[i].stddev;
+        CHECK_NEAR(collage[i].skewness, 0.0, 1e-12);
+        CHECK_NEAR(collage[i].kurtosis, -1.2 * var * var / ((var + noise_var) * (var + noise_var)), 1e-12);
+    }
+}
+
+int main()
+{
+    testNoiseless();
+    testNoise();
+    testCollage();
+    return checkResult();
+}
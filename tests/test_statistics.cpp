@@ -0,0 +1,189 @@
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <methods.h>
+#include "check.h"
+
+// Квантили распределения на равномерной сетке вероятностей: выборочные
+// статистики близки к теоретическим без случайного шума
+static std::vector<double> exponentialSample(int n)
+{
+    std::vector<double> values(n);
+    for (int i = 0; i < n; i++)
+        values[i] = -std::log(1.0 - (i + 0.5) / n);
+    return values;
+}
+
+static std::vector<double> uniformSample(int n, double lo, double hi)
+{
+    std::vector<double> values(n);
+    for (int i = 0; i < n; i++)
+        values[i] = lo + (hi - lo) * (i + 0.5) / n;
+    return values;
+}
+
+// Квантильные статистики выводятся только из гистограммы
+static CellStatistics statisticsOf(const std::vector<double> &values)
+{
+    CellStatistics statistics;
+    for (double v : values)
+        statistics.histogram.add(v);
+    return statistics;
+}
+
+// Экспоненциальное: tau3 = 1/3, tau4 = 1/6, medcouple = 1/3,
+// Боули = ln(4/3) / ln 3
+static void testExponential()
+{
+    const CellStatistics statistics = statisticsOf(exponentialSample(100000));
+    CHECK_NEAR(statistics.value(STAT_L_SKEWNESS), 1.0 / 3.0, 0.01);
+    CHECK_NEAR(statistics.value(STAT_L_KURTOSIS), 1.0 / 6.0, 0.01);
+    CHECK_NEAR(statistics.value(STAT_MEDCOUPLE), 1.0 / 3.0, 0.01);
+    CHECK_NEAR(statistics.value(STAT_BOWLEY), std::log(4.0 / 3.0) / std::log(3.0), 0.01);
+}
+
+// Симметричные данные: все меры асимметрии нулевые; равномерное — tau4 = 0
+static void testSymmetric()
+{
+    const CellStatistics uniform = statisticsOf(uniformSample(50000, -3.0, 5.0));
+    CHECK_NEAR(uniform.value(STAT_L_SKEWNESS), 0.0, 0.005);
+    CHECK_NEAR(uniform.value(STAT_L_KURTOSIS), 0.0, 0.005);
+    CHECK_NEAR(uniform.value(STAT_BOWLEY), 0.0, 0.005);
+    CHECK_NEAR(uniform.value(STAT_MEDCOUPLE), 0.0, 0.005);
+
+    // Два пика: распределение симметрично, но далеко от равномерного
+    std::vector<double> values = exponentialSample(20000);
+    const size_t half = values.size();
+    for (size_t i = 0; i < half; i++)
+        values.push_back(-values[i]);
+    const CellStatistics twin = statisticsOf(values);
+    CHECK_NEAR(twin.value(STAT_L_SKEWNESS), 0.0, 0.005);
+    CHECK_NEAR(twin.value(STAT_BOWLEY), 0.0, 0.005);
+    CHECK_NEAR(twin.value(STAT_MEDCOUPLE), 0.0, 0.005);
+}
+
+// Слияние скетчей с разными диапазонами и ширинами корзин совпадает
+// с одним проходом по объединению с точностью до ширины корзины
+static void testMerge()
+{
+    const std::vector<double> a = uniformSample(10000, 0.0, 1.0);
+    const std::vector<double> b = exponentialSample(30000);
+    std::vector<double> all = a;
+    for (double v : b)
+        all.push_back(v * 250.0 + 40.0);
+
+    HistogramSketch left, right, single;
+    for (double v : a)
+    {
+        left.add(v);
+        single.add(v);
+    }
+    for (double v : b)
+    {
+        right.add(v * 250.0 + 40.0);
+        single.add(v * 250.0 + 40.0);
+    }
+    HistogramSketch merged = left;
+    merged.merge(right);
+
+    CHECK_NEAR(merged.total(), static_cast<double>(all.size()), 1e-9);
+    std::sort(all.begin(), all.end());
+    const double width = std::max(merged.binWidth(), single.binWidth());
+    for (double p : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99})
+    {
+        CHECK_NEAR(merged.quantile(p), single.quantile(p), 2.0 * width);
+        CHECK_NEAR(merged.quantile(p), all[static_cast<size_t>(p * (all.size() - 1))], 2.0 * width);
+    }
+
+    // Порядок слияния не влияет на результат
+    HistogramSketch reversed = right;
+    reversed.merge(left);
+    CHECK(reversed.exponent == merged.exponent);
+    CHECK_NEAR(reversed.quantile(0.5), merged.quantile(0.5), 1e-9 * width);
+
+    // Пустой скетч — нейтральный элемент
+    HistogramSketch empty;
+    HistogramSketch copy = merged;
+    copy.merge(empty);
+    CHECK(copy.origin == merged.origin && copy.counts == merged.counts);
+    empty.merge(merged);
+    CHECK(empty.origin == merged.origin && empty.counts == merged.counts);
+}
+
+static void testReduce()
+{
+    HistogramSketch sketch;
+    for (double v : exponentialSample(20000))
+        sketch.add(v);
+    const double before_width = sketch.binWidth();
+    const double median = sketch.quantile(0.5);
+
+    sketch.reduce(64);
+    CHECK(sketch.binWidth() > before_width);
+    CHECK_NEAR(sketch.total(), 20000.0, 1e-9);
+    int first = 0, last = HistogramSketch::BINS - 1;
+    while (first < HistogramSketch::BINS && sketch.counts[first] == 0.0)
+        first++;
+    while (last >= 0 && sketch.counts[last] == 0.0)
+        last--;
+    CHECK(last - first < 64);
+    CHECK_NEAR(sketch.quantile(0.5), median, sketch.binWidth());
+
+    // Уже укладывается — ширина не меняется
+    const int exponent = sketch.exponent;
+    sketch.reduce(64);
+    CHECK(sketch.exponent == exponent);
+}
+
+// Нечисловые значения пропускаются, вырожденная ячейка даёт нули
+static void testDegenerate()
+{
+    HistogramSketch sketch;
+    sketch.add(std::numeric_limits<double>::quiet_NaN());
+    sketch.add(std::numeric_limits<double>::infinity());
+    CHECK(sketch.empty());
+    sketch.add(1.5);
+    sketch.add(-std::numeric_limits<double>::infinity());
+    CHECK_NEAR(sketch.total(), 1.0, 0.0);
+
+    const CellStatistics constant = statisticsOf(std::vector<double>(100, 7.0));
+    CHECK_NEAR(constant.value(STAT_BOWLEY), 0.0, 0.0);
+    CHECK_NEAR(constant.value(STAT_MEDCOUPLE), 0.0, 0.0);
+    CHECK_NEAR(constant.value(STAT_L_SKEWNESS), 0.0, 0.0);
+}
+
+// getChannelStatistics по изображению совпадает со скетчем по тем же
+// значениям; без квантильных статистик гистограмма не строится
+static void testImage()
+{
+    const std::vector<double> values = exponentialSample(4096);
+    cv::Mat image(64, 64, CV_64FC1);
+    for (int i = 0; i < 4096; i++)
+        image.at<double>(i / 64, i % 64) = values[i];
+    std::vector<Span> spans;
+    for (int y = 0; y < 64; y++)
+        spans.push_back({y, 0, 64});
+
+    const std::vector<CellStatistics> full = getChannelStatistics(image, spans, STAT_ALL);
+    CHECK(full.size() == 1);
+    const CellStatistics reference = statisticsOf(values);
+    for (StatisticFlags statistic : {STAT_BOWLEY, STAT_MEDCOUPLE, STAT_L_SKEWNESS, STAT_L_KURTOSIS})
+        CHECK_NEAR(full[0].value(statistic), reference.value(statistic), 1e-9);
+    CHECK_NEAR(full[0].value(STAT_SKEWNESS), getChannelMoments(image, spans)[0].skewness(), 1e-12);
+
+    const std::vector<CellStatistics> moments = getChannelStatistics(image, spans, STAT_MOMENTS);
+    CHECK(moments.size() == 1 && moments[0].histogram.empty());
+}
+
+int main()
+{
+    testExponential();
+    testSymmetric();
+    testMerge();
+    testReduce();
+    testDegenerate();
+    testImage();
+    return checkResult();
+}